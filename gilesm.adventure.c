@@ -3,21 +3,27 @@
  * Filename: adventure.c
  * Date Created: 10/22/2015
  * Date Last Modified: 10/22/2015
- * Description: This is an adventure game that creates 7 random rooms, creates
- *   a starting room, an ending room, up to five rooms in between, and the
- *   connections between rooms. A user will be placed in the starting room, and
- *   use the provided interface to navigate between rooms. Once a user reaches
- *   the ending room, the game is over and the user wins. Upon completion, the
- *   program will display a message to the user, and indicate the number of
- *   steps taken as well as display the path taken by room name.
+ * Description: This is an adventure game that creates 7 random rooms (or as
+ *   many as requested with --rooms), creates a starting room, an ending room,
+ *   the rooms in between, and the connections between rooms. A user will be
+ *   placed in the starting room, and use the provided interface to navigate
+ *   between rooms. Once a user reaches the ending room, the game is over and
+ *   the user wins. Upon completion, the program will display a message to the
+ *   user, and indicate the number of steps taken as well as display the path
+ *   taken by room name.
  *
- * Input: The program will read data from files that contain room information
+ * Input: The program will read data from a world file that contains room
+ *   information (either the one it just generated or one named with --world)
  *   as well as receive input from the user through standard input (keyboard)
  *   for navigation.
  *
- * Output: The program will write randomly selected room data to files to
- *   create a dynamically gaming experience and will also use standard output
- *   (display to the screen) for the user interface and communication.
+ * Output: The program will write randomly selected room data to a binary
+ *   world file in the background (unless --no-save is given) to create a
+ *   dynamically gaming experience, and with --export-text also to one readable
+ *   text file per room. It will also use standard output (display to the
+ *   screen) for the user interface and communication, and with --trace
+ *   writes a binary step trace of the path taken once the game is won, or
+ *   with --trace-log appends the game to a shared log that can be replayed.
  *
  *****************************************************************************/
 #include <stdio.h>
@@ -28,258 +34,255 @@
 #include <fcntl.h>
 #include <string.h>
 #include <time.h>
-
-struct Room {
-	char name[50];						// label/name
-	char type[15];						// START_ROOM, END_ROOM, MID_ROOM
-	int numActiveConn;					// number of current connections
-	int connections[7];					// rooms that this room connects to
-};
-
-struct Game {
-	struct Room roomList[7];			// room information for this game
-	char nameList[10][50];				// list of available names
-	int numNamesRemaining;				// number of names remaining in list
-	int stepCount;						// tracks number of steps taken
-	int processID;						// process ID of current game
-	char dirPath[512];					// path of directory for files
-	char stepFileName[512];				// name of step history file 
-	int startRoomIndex;					// room list index of starting room
-	int endRoomIndex;					// room list index of ending room
-};
-
-// takes a game structure, a room index, and adds a connection to that room
-void addRoomConn(struct Game *currentGame, int roomIndex);
-// assign room names, room connections, and save room files to directory
-void buildGame(struct Game *currentGame);
-// populate room files with description/information for a specified room number
-void writeRoomFile(struct Game *currentGame, int roomNumber);
-// read room file contents into local structure for a specified room number
-void readRoomFile(struct Game *currentGame, int roomNumber);
-// create a room file for the game with a specified file number.
-void createRoomFile(struct Game *currentGame, int roomNumber);
-// Display the congratulatory messages to the user
-void displayGameResults(struct Game *currentGame);
-// Retrieve random name from names list and decrement number remaining by 1
-void getRandomName(struct Game *currentGame, char *name);
-// initialize the game attributes, room name list, and directory path
-void initGame(struct Game *currentGame);
-// allow player to play game until end room is reached
-void playGame(struct Game *currentGame);
-
-int main() {
-	// initialize game structure and allocate memory
-	struct Game *currentGame;
-	currentGame = (struct Game *)malloc(sizeof(struct Game));
-	// initialize seed for random number generator
-	srand (time(NULL));
-	// initialize the game attributes, room name list, and directory path
-	initGame(currentGame);
-	// assign room names, room connections, and save room files to directory
-	buildGame(currentGame);
-	// allow player to play game until end room is reached
-	playGame(currentGame);
-    // display congratulations, step count, and step history path to the user
-	displayGameResults(currentGame);
-	// clean game data
-	remove(currentGame->stepFileName);
-	free(currentGame); 
-    
-	// exit with value 0
-    return 0;
-}
+#include <pthread.h>
+#include <errno.h>
+#include "gilesm.adventure.h"
+#include "gilesm.worldfile.h"
+#include "gilesm.worldshm.h"
+#include "gilesm.roomcache.h"
+#include "gilesm.filebatch.h"
+#include "gilesm.stats.h"
+#include "gilesm.console.h"
+#include "gilesm.fixed.h"
 
 /******************************************************************************
  * Function Name: buildGame
- * Description: Assign room names, room connections, and save room files to
- *   directory.
+ * Description: Assign room names and room connections. A random spanning
+ *   tree joins every room first, then extra connections bring each room up
+ *   to the minimum, so no choice is ever retried and the end room is always
+ *   reachable. Classic worlds are joined by the fixed engine, which makes
+ *   the same choices. The generated world stays in memory and is what the
+ *   game plays; saving it is left to saveGame.
  *****************************************************************************/
 void buildGame(struct Game *currentGame) {
-	int status,					// success/fail for directory and file creation
-		i = 0,					// iterator for control structures
-		j = 0,					// iterator for control structures
-		numConnToAdd;			// number of connections selected for this room
-	char *fileName = malloc(sizeof(char) * 10),
-		 *roomName = malloc(sizeof(char) * 50);
+	int i = 0;					// iterator for control structures
+	char *roomName = allocArena(&currentGame->scratch, ROOM_NAME_SIZE);
+	struct World *world = &currentGame->world;
+	struct Random fixedStart;		// random stream before the fixed engine ran
+	uint64_t start = startStatTimer();
 		
-	// create room files while assigning name, type, and connections
-	for (i = 0; i < 7; i++) {
+	// assign every room a name and type based on random selections
+	for (i = 0; i < world->numRooms; i++) {
 		// select random name from name list
 		getRandomName(currentGame, roomName);
 		// save random name to room structure
-		strcpy(currentGame->roomList[i].name, roomName);
-	
-		// add connections to this room until it has at least 3
-		while (currentGame->roomList[i].numActiveConn < 3) {
-			addRoomConn(currentGame, i);
-		}
+		setRoomName(world, i, roomName);
 
-		// assign a room type based on random selections
-		if (currentGame->startRoomIndex == i) {
-			strcpy(currentGame->roomList[i].type, "START_ROOM");
-		} else if (currentGame->endRoomIndex == i) {
-			strcpy(currentGame->roomList[i].type, "END_ROOM");
+		if (world->startRoomIndex == i) {
+			world->roomList[i].type = START_ROOM;
+		} else if (world->endRoomIndex == i) {
+			world->roomList[i].type = END_ROOM;
 		} else {
-			strcpy(currentGame->roomList[i].type, "MID_ROOM");
+			world->roomList[i].type = MID_ROOM;
 		}
 	}
+	resetArena(&currentGame->scratch);
+
+	// classic worlds are joined, packed, and checked on the stack; a room
+	// the fixed engine cannot fill is built again by the runtime engine from
+	// the same draws, which goes on to repair it
+	if (currentGame->fixedEngine) {
+		fixedStart = currentGame->random;
+		if (addFixedConns(currentGame) == 0) {
+			indexRoomNames(world);
+			stopStatTimer(STAT_BUILD_GAME, start);
+			return;
+		}
+		currentGame->random = fixedStart;
+	}
+
+	// join all rooms, then add connections to each room until it has the
+	// minimum, rewiring other connections once no room can take one
+	addSpanningConns(currentGame);
+	for (i = 0; i < world->numRooms; i++) {
+		while (currentGame->builder.numConn[i] < currentGame->minConn &&
+		       (addRoomConn(currentGame, i) || repairRoomConn(currentGame, i))) {
+		}
+	}
+
+	// pack the generated connections into the world and index the names
+	packWorldConns(&currentGame->builder, world);
+	indexRoomNames(world);
+
+	// the spanning tree makes this impossible, but a broken world must
+	// never reach a player; small worlds check with a bitset search
+	if (currentGame->builder.matrix.rows != NULL ?
+	    countMatrixReachable(&currentGame->builder.matrix, 0) != world->numRooms :
+	    countWorldRegions(world) != 1) {
+		fprintf(stderr, "Generated world is not connected.\n");
+		exit(1);
+	}
+	for (i = 0; i < world->numRooms; i++) {
+		if (getNumConns(world, i) < currentGame->minConn) {
+			fprintf(stderr, "Generated room %d has %d connections, fewer than %d.\n",
+			        i, getNumConns(world, i), currentGame->minConn);
+			exit(1);
+		}
+	}
+	stopStatTimer(STAT_BUILD_GAME, start);
+}
 
-	// populate room files with description/information
-	for (i = 0; i < 7; i++) {
-		writeRoomFile(currentGame, i);
+/******************************************************************************
+ * Function Name: formatRoomFile
+ * Description: Returns the whole description of a room as it appears in its
+ *   room file, formatted in the specified arena, and stores its length.
+ *****************************************************************************/
+char *formatRoomFile(const struct World *world, int roomNumber, struct Arena *arena, size_t *length) {
+	const int *conns = getConns(world, roomNumber);
+	const char *roomType = getRoomTypeName(world->roomList[roomNumber].type);
+	size_t size = 11 + world->roomList[roomNumber].nameLength + 1 + 11 + strlen(roomType) + 2;
+	char *text;
+	int i = 0;
+
+	// size the description for the name, every connection, and the type
+	for (i = 0; i < getNumConns(world, roomNumber); i++) {
+		size += 24 + world->roomList[conns[i]].nameLength;
 	}
+	text = allocArena(arena, size);
 
-	// read room file contents into local game structure
-	for (i = 0; i < 7; i++) {
-		readRoomFile(currentGame, i);
+	// concatenate text with data to be written to the file
+	*length = sprintf(text, "ROOM NAME: %s\n", getRoomName(world, roomNumber));
+	for (i = 0; i < getNumConns(world, roomNumber); i++) {
+		*length += sprintf(text + *length, "CONNECTION %i: %s\n", i + 1, getRoomName(world, conns[i]));
 	}
-	free(fileName);
-	free(roomName);
+	*length += sprintf(text + *length, "ROOM TYPE: %s\n", roomType);
+	return text;
 }
 
 /******************************************************************************
  * Function Name: writeRoomFile
  * Description: Populate room file with description/information for a specified
- *   file number.
+ *   file number. The file name and the whole room description are formatted
+ *   in the game's scratch arena, the description is written with one write,
+ *   and the scratch arena is reset for the next room.
  *****************************************************************************/
 void writeRoomFile(struct Game *currentGame, int roomNumber) {
-	char *fileName = malloc(sizeof(char) * 10);
-	char *roomName = malloc(sizeof(char) * 61);
-	char *roomType = malloc(sizeof(char) * 26);
-	char *connectionRoomName = malloc(sizeof(char) * 64);
+	size_t length = 0;
+	char *fileName = allocArena(&currentGame->scratch, strlen(currentGame->dirPath) + 32),
+		 *text = formatRoomFile(&currentGame->world, roomNumber, &currentGame->scratch, &length);
 	int file_descriptor;
-	int i = 0;
-	int connectionNumber = 1;
 	ssize_t nwritten;
+	uint64_t start = startStatTimer();
 
-	// concatenate text with data to be written to the file
 	sprintf(fileName, "%s/file%d", currentGame->dirPath, roomNumber);
-	sprintf(roomName, "ROOM NAME: %s\n", currentGame->roomList[roomNumber].name);
-	sprintf(roomType, "ROOM TYPE: %s\n", currentGame->roomList[roomNumber].type);
-
-	// open file for writing
-	file_descriptor = open(fileName, O_RDWR);
+	// open file for writing, dropping anything a longer room left behind
+	file_descriptor = open(fileName, O_RDWR | O_TRUNC);
 	// check to see if file opened successfully
 	if (file_descriptor == -1) {
 		fprintf(stderr, "Could not open %s to write to file.\n", fileName);
 		exit(1);
 	}
-	// write the room name to the file
-	nwritten = write(file_descriptor, roomName, strlen(roomName));
-	// write each connecting room name to file
-	for (i = 0; i < 7; i++) {
-		if (currentGame->roomList[roomNumber].connections[i] == 1 && roomNumber != i) {
-			sprintf(connectionRoomName, "CONNECTION %i: %s\n", connectionNumber, currentGame->roomList[i].name);
-			nwritten = write(file_descriptor, connectionRoomName, strlen(connectionRoomName));
-			connectionNumber++;
-		}
-	}
-	// write the room type to the file
-	nwritten = write(file_descriptor, roomType, strlen(roomType));
+	// write the whole room to the file
+	nwritten = write(file_descriptor, text, length);
 	// close the file
 	close(file_descriptor);
-	// clean up pointers
-	fileName = NULL;
-	roomName = NULL;
-	roomType = NULL;
-	connectionRoomName = NULL;
-	// restore dynamic memory
-	free(fileName);
-	free(roomName);
-	free(roomType);
-	free(connectionRoomName);
+	countStatIo(STAT_IO_ROOM_FILES, 3, nwritten > 0 ? nwritten : 0);
+	// release the room's buffers all at once
+	resetArena(&currentGame->scratch);
+	stopStatTimer(STAT_WRITE_ROOM_FILE, start);
+}
+
+// returns the text after a line's prefix, or NULL if the line lacks it
+static char *matchRoomField(char *line, size_t length, const char *prefix) {
+	size_t prefixLength = strlen(prefix);
+
+	if (length < prefixLength || memcmp(line, prefix, prefixLength) != 0) {
+		return NULL;
+	}
+	return line + prefixLength;
+}
+
+/******************************************************************************
+ * Function Name: parseRoomFile
+ * Description: Read the text of a room file, already in memory, into local
+ *   game structure for a specified room number. The text is split into
+ *   lines with memchr; each field is used where it lies in the buffer,
+ *   ended in place, so names of any length are read without being copied.
+ *   The text must have a byte to spare after its end for ending the last
+ *   line.
+ *****************************************************************************/
+void parseRoomFile(struct Game *currentGame, int roomNumber, char *text, size_t length) {
+	struct World *world = &currentGame->world;
+	char *line,
+		 *lineEnd,
+		 *textEnd = text + length,
+		 *field;
+	int i = 0;
+
+	// store each row's value based on what the row holds
+	for (line = text; line < textEnd; line = lineEnd + 1) {
+		lineEnd = memchr(line, '\n', textEnd - line);
+		if (lineEnd == NULL) {
+			lineEnd = textEnd;
+		}
+		// end the field in place, dropping a carriage return
+		length = lineEnd - line;
+		if (length > 0 && line[length - 1] == '\r') {
+			length--;
+		}
+		line[length] = '\0';
+
+		if ((field = matchRoomField(line, length, "ROOM NAME: ")) != NULL) {
+			setRoomName(world, roomNumber, field);
+		} else if ((field = matchRoomField(line, length, "CONNECTION ")) != NULL) {
+			// skip the connection number to the name after ": "
+			field = memchr(field, ':', line + length - field);
+			if (field != NULL && field[1] == ' ') {
+				field += 2;
+				// look up the connected room through the name index
+				i = findRoom(world, field, line + length - field);
+				if (i != -1) {
+					addBuilderConn(&currentGame->builder, roomNumber, i);
+				}
+			}
+		} else if ((field = matchRoomField(line, length, "ROOM TYPE: ")) != NULL) {
+			world->roomList[roomNumber].type = parseRoomType(field);
+		}
+	}
 }
 
 /******************************************************************************
  * Function Name: readRoomFile
  * Description: Read room file contents into local game structure for a
- *   specified room number.
+ *   specified room number. The whole file is read at once into the game's
+ *   scratch arena and parsed there with parseRoomFile. Exits if the file
+ *   cannot be read.
  *****************************************************************************/
 void readRoomFile(struct Game *currentGame, int roomNumber) {
-	char buffer[512] = "",
-	     fileName[10] = "",
-	     roomName[50] = "",
-	     roomType[15] = "",
-	     connectionRoomName[50] = "",
-	     c,
-	     subBuff[10];
-	int count = 0,
-	    i = 0,
-	    index = 0;
+	char *fileName = allocArena(&currentGame->scratch, strlen(currentGame->dirPath) + 32),
+		 *text;
+	size_t length = 0;
+	ssize_t nread = 0;
+	struct stat fileStat;
+	int file_descriptor,
+		numCalls = 3;
+	uint64_t start = startStatTimer();
+
 	// concatenate directory path and file name
 	sprintf(fileName, "%s/file%d", currentGame->dirPath, roomNumber);
-	// open file pointer for reading
-	FILE *fp = fopen(fileName, "r");
-	// read each character of the file until the end
-	while ((c = fgetc(fp)) !=  EOF) {
-		if (c == '\n') {
-			buffer[count] = c;
-			// determine which type of row is being read
-			for (i = 0; i < 10; i++) {
-				subBuff[i] = buffer[i];
-			}
-			// store appropriate value based on what the row holds
-			if (strcmp(subBuff, "ROOM NAME:") == 0) {
-				index = 11;
-				count = 0;
-				while (count < 50) {
-					if (buffer[index] == '\n') {
-						buffer[index] = '\0';
-					} else {
-						roomName[count] = buffer[index];
-					}
-					count++;
-					index++;
-				}
-				strcpy(currentGame->roomList[roomNumber].name, roomName);
-			} else if (strcmp(subBuff, "CONNECTION") == 0) {
-				index = 14;
-				count = 0;
-				while (count < 50) {
-					if (buffer[index] == '\n') {
-						buffer[index] = '\0';
-					} else {
-						connectionRoomName[count] = buffer[index];
-					}
-					count++;
-					index++;
-				}
-				
-				for ( i = 0; i < 7; i++) {
-					if (strcmp(connectionRoomName, currentGame->roomList[i].name) == 0) {
-						currentGame->roomList[roomNumber].connections[i] = 1;
-					}
-				}
-				for (i = 0; i < 50; i++) {
-					connectionRoomName[i] = '\0';
-				}
-			} else if (strcmp(subBuff, "ROOM TYPE:") == 0) {
-				index = 11;
-				count = 0;
-				while (count < 15) {
-					if (buffer[index] == '\n') {
-						buffer[index] = '\0';
-					} else {
-						roomType[count] = buffer[index];
-					}
-					count++;
-					index++;
-				}
-				strcpy(currentGame->roomList[roomNumber].type, roomType);
-			}
-			// clear buffer variable for re-use
-			for (i = 0; i < 512; i++) {
-				buffer[i] = '\0';
-			}
-			count = 0;
-		} else {
-			// if not newline, store character and add to total characters read
-			buffer[count] = c;
-			count++;
-		}
+	file_descriptor = open(fileName, O_RDONLY);
+	if (file_descriptor == -1 || fstat(file_descriptor, &fileStat) == -1) {
+		fprintf(stderr, "Could not open %s to read the file.\n", fileName);
+		exit(1);
+	}
+	// read the whole file, with a byte to spare for ending the last line
+	text = allocArena(&currentGame->scratch, fileStat.st_size + 1);
+	while (length < (size_t)fileStat.st_size &&
+	       (nread = read(file_descriptor, text + length, fileStat.st_size - length)) > 0) {
+		length += nread;
+		numCalls++;
+	}
+	close(file_descriptor);
+	countStatIo(STAT_IO_ROOM_FILES, numCalls, length);
+	if (nread == -1) {
+		fprintf(stderr, "Could not read %s.\n", fileName);
+		exit(1);
 	}
-	// close the file	
-	fclose(fp);
+
+	parseRoomFile(currentGame, roomNumber, text, length);
+	// release the file name and text all at once
+	resetArena(&currentGame->scratch);
+	stopStatTimer(STAT_READ_ROOM_FILE, start);
 }
 
 /******************************************************************************
@@ -287,7 +290,7 @@ void readRoomFile(struct Game *currentGame, int roomNumber) {
  * Description: Create a room file for the game with a specified file number.
  *****************************************************************************/
 void createRoomFile(struct Game *currentGame, int roomNumber) {
-	char *fileName = malloc(sizeof(char) * 10);
+	char *fileName = allocArena(&currentGame->scratch, strlen(currentGame->dirPath) + 32);
 	int file_descriptor;
 	sprintf(fileName, "%s/file%d", currentGame->dirPath, roomNumber);
 	// open and create file
@@ -298,212 +301,862 @@ void createRoomFile(struct Game *currentGame, int roomNumber) {
 	}
 	// close the file
 	close(file_descriptor);
-	// free pointer
-	fileName = NULL;
-	// free dynamic memory
-	free(fileName);
+	countStatIo(STAT_IO_ROOM_FILES, 2, 0);
+	// release the file name
+	resetArena(&currentGame->scratch);
+}
+
+/******************************************************************************
+ * Function Name: exportRoomFiles
+ * Description: Write every room of the world to its own readable text file in
+ *   the game directory. Each room is formatted into a file batch, which
+ *   creates and writes the files FILE_BATCH_SIZE at a time, through io_uring
+ *   where the kernel allows it. The binary world file remains what the game
+ *   plays; the text files exist for debugging. Exits if any file fails.
+ *****************************************************************************/
+void exportRoomFiles(struct Game *currentGame) {
+	struct FileBatch batch;
+	size_t length = 0;
+	char *fileName,
+		 *text;
+	int i = 0;
+	uint64_t start = startStatTimer();
+
+	initFileBatch(&batch, 1);
+	for (i = 0; i < currentGame->world.numRooms; i++) {
+		fileName = allocArena(&batch.arena, strlen(currentGame->dirPath) + 32);
+		sprintf(fileName, "%s/file%d", currentGame->dirPath, i);
+		text = formatRoomFile(&currentGame->world, i, &batch.arena, &length);
+		addBatchFile(&batch, fileName, text, length);
+	}
+	if (flushFileBatch(&batch) == -1) {
+		exit(1);
+	}
+	countStatIo(STAT_IO_ROOM_FILES, batch.numCalls, batch.numBytes);
+	freeFileBatch(&batch);
+	stopStatTimer(STAT_EXPORT_ROOM_FILES, start);
+}
+
+/******************************************************************************
+ * Function Name: loadGame
+ * Description: Replace the game's world with one mapped read-only from a
+ *   binary world file. Exits if the file cannot be used.
+ *****************************************************************************/
+void loadGame(struct Game *currentGame, const char *fileName) {
+	freeWorld(&currentGame->world);
+	if (loadWorldFile(&currentGame->world, fileName) == -1) {
+		exit(1);
+	}
+}
+
+/******************************************************************************
+ * Function Name: attachGame
+ * Description: Replace the game's world with one published in shared memory
+ *   by another process, mapped read-only. Exits if there is no usable world
+ *   under the name.
+ *****************************************************************************/
+void attachGame(struct Game *currentGame, const char *shmName) {
+	freeWorld(&currentGame->world);
+	if (attachWorld(&currentGame->world, shmName) == -1) {
+		exit(1);
+	}
+}
+
+/******************************************************************************
+ * Function Name: saveGameThread
+ * Description: Background thread body for saveGame. The world is not changed
+ *   once built, so it can be read here while the player moves through it.
+ *****************************************************************************/
+static void *saveGameThread(void *arg) {
+	struct Game *currentGame = arg;
+
+	// save the whole world to a single binary file
+	if (currentGame->saveWorld) {
+		writeWorldFile(&currentGame->world, currentGame->worldFileName);
+	}
+	// write readable room files when asked
+	if (currentGame->exportText) {
+		exportRoomFiles(currentGame);
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Function Name: saveGame
+ * Description: Start writing the binary world file and any requested text
+ *   room files on a background thread, so the first prompt does not wait on
+ *   disk. Falls back to saving inline if no thread can be started.
+ *****************************************************************************/
+void saveGame(struct Game *currentGame) {
+	currentGame->saveStarted = 0;
+	if (!currentGame->saveWorld && !currentGame->exportText) {
+		return;
+	}
+	if (pthread_create(&currentGame->saveThread, NULL, saveGameThread, currentGame) == 0) {
+		currentGame->saveStarted = 1;
+	} else {
+		saveGameThread(currentGame);
+	}
+}
+
+/******************************************************************************
+ * Function Name: finishSaveGame
+ * Description: Wait for the background save started by saveGame, if any.
+ *****************************************************************************/
+void finishSaveGame(struct Game *currentGame) {
+	if (currentGame->saveStarted) {
+		pthread_join(currentGame->saveThread, NULL);
+		currentGame->saveStarted = 0;
+	}
+}
+
+/******************************************************************************
+ * Function Name: addSpanningConns
+ * Description: Connect every room into a single region with a random
+ *   spanning tree. Rooms join the tree in random order, each linked to a
+ *   random tree room that still has a free connection slot, so every room
+ *   is reachable from every other without a single retry.
+ *****************************************************************************/
+void addSpanningConns(struct Game *currentGame) {
+	struct WorldBuilder *builder = &currentGame->builder;
+	// joining order, and tree rooms with free slots, for this call only
+	int *order = allocArena(&currentGame->scratch, sizeof(int) * builder->numRooms),
+		*frontier = allocArena(&currentGame->scratch, sizeof(int) * builder->numRooms),
+		numFrontier = 0,
+		i = 0,
+		j = 0,
+		swap,
+		position,
+		parent;
+	uint64_t start = startStatTimer();
+
+	// shuffle the rooms into a random joining order
+	for (i = 0; i < builder->numRooms; i++) {
+		order[i] = i;
+	}
+	for (i = builder->numRooms - 1; i > 0; i--) {
+		j = randomBelow(&currentGame->random, i + 1);
+		swap = order[i];
+		order[i] = order[j];
+		order[j] = swap;
+	}
+
+	// grow the tree one room at a time from the first room in the order
+	frontier[numFrontier++] = order[0];
+	for (i = 1; i < builder->numRooms && numFrontier > 0; i++) {
+		position = randomBelow(&currentGame->random, numFrontier);
+		parent = frontier[position];
+		linkBuilderRooms(builder, parent, order[i]);
+		// retire the parent once it is full, keep the new room if it is not
+		if (builder->numConn[parent] >= builder->maxConn) {
+			frontier[position] = frontier[--numFrontier];
+		}
+		if (builder->numConn[order[i]] < builder->maxConn) {
+			frontier[numFrontier++] = order[i];
+		}
+	}
+
+	resetArena(&currentGame->scratch);
+	stopStatTimer(STAT_SPANNING_CONNS, start);
 }
 
 /******************************************************************************
  * Function Name: addRoomConn
  * Description: Takes a game structure and a specfied room and adds to it a
- *   connection to another room.
+ *   connection to another room. Only rooms with a free slot are considered,
+ *   starting from a random one, and at most maxConn of them can be refused
+ *   (the room itself and rooms already connected), so the search is short.
+ *   Returns 1 if a connection was added or 0 if no room can take one.
  *****************************************************************************/
-void addRoomConn(struct Game *currentGame, int roomIndex) {
-	int connectionEstablished = 0,
-		randomSelection = -1;
-	
-	// search for random connection match until established
-	while (connectionEstablished == 0) {
-		// generate random number between 0 and 6
-		randomSelection = (rand() % 7);
-		// add connection if not at max and if connection doesn't already exist
-		if (currentGame->roomList[roomIndex].connections[randomSelection] == 0) {
-				currentGame->roomList[roomIndex].connections[randomSelection] = 1;
-				currentGame->roomList[randomSelection].connections[roomIndex] = 1;
-				currentGame->roomList[roomIndex].numActiveConn++;
-				currentGame->roomList[randomSelection].numActiveConn++;
-				connectionEstablished = 1;
+int addRoomConn(struct Game *currentGame, int roomIndex) {
+	struct WorldBuilder *builder = &currentGame->builder;
+	uint64_t timerStart = startStatTimer();
+	int start,
+		i = 0;
+
+	if (builder->numConn[roomIndex] >= builder->maxConn || builder->numOpen < 2) {
+		countStat(STAT_CONN_FAILURES, 1);
+		stopStatTimer(STAT_ADD_ROOM_CONN, timerStart);
+		return 0;
+	}
+	// walk the open rooms from a random starting point until one accepts
+	start = randomBelow(&currentGame->random, builder->numOpen);
+	for (i = 0; i < builder->numOpen; i++) {
+		if (linkBuilderRooms(builder, roomIndex, builder->openRooms[(start + i) % builder->numOpen])) {
+			countStat(STAT_CONN_REFUSALS, i);
+			stopStatTimer(STAT_ADD_ROOM_CONN, timerStart);
+			return 1;
 		}
 	}
+	countStat(STAT_CONN_REFUSALS, i);
+	countStat(STAT_CONN_FAILURES, 1);
+	stopStatTimer(STAT_ADD_ROOM_CONN, timerStart);
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: repairRoomConn
+ * Description: Give a room that addRoomConn could not bring up to the
+ *   minimum more connections by rewiring a connection between two other
+ *   rooms, so no other room's degree changes and every room stays reachable.
+ *   With two free slots, a connection a-b between rooms it does not connect
+ *   to becomes a-room and room-b. With one, which only happens when every
+ *   room needs exactly as many connections as it may have, another room
+ *   still short of the maximum is already connected to it, and a-b becomes
+ *   a-room and other-b. Returns 1 if connections were added or 0 if no
+ *   connection can be rewired.
+ *****************************************************************************/
+int repairRoomConn(struct Game *currentGame, int roomIndex) {
+	struct WorldBuilder *builder = &currentGame->builder;
+	const int *slots;
+	int otherRoom = roomIndex,
+		first = 0,
+		second,
+		i = 0;
+
+	if (builder->numConn[roomIndex] >= builder->maxConn) {
+		return 0;
+	}
+	// with one free slot, the second end goes to another room short of the maximum
+	if (builder->numConn[roomIndex] + 1 == builder->maxConn) {
+		for (i = 0; i < builder->numOpen && otherRoom == roomIndex; i++) {
+			if (builder->openRooms[i] != roomIndex) {
+				otherRoom = builder->openRooms[i];
+			}
+		}
+		if (otherRoom == roomIndex) {
+			return 0;
+		}
+	}
+
+	// find a connection whose first end can take the room and second end the other room
+	for (first = 0; first < builder->numRooms; first++) {
+		if (first == roomIndex || first == otherRoom || hasBuilderConn(builder, first, roomIndex)) {
+			continue;
+		}
+		slots = builder->conns + (size_t)first * builder->maxConn;
+		for (i = 0; i < builder->numConn[first]; i++) {
+			second = slots[i];
+			if (second == roomIndex || second == otherRoom || hasBuilderConn(builder, second, otherRoom)) {
+				continue;
+			}
+			replaceBuilderConn(builder, first, second, roomIndex);
+			replaceBuilderConn(builder, second, first, otherRoom);
+			addBuilderConn(builder, roomIndex, first);
+			addBuilderConn(builder, otherRoom, second);
+			countStat(STAT_CONN_REPAIRS, 1);
+			return 1;
+		}
+	}
+	return 0;
 }
 
 /******************************************************************************
  * Function Name: getRandomName
- * Description: Selects a random name from the game list, removes the name, and
- *   updates the total number of names remaining.
+ * Description: Selects a random name from the game's name list that no other
+ *   room of the world has, in constant time, and copies it into a
+ *   ROOM_NAME_SIZE buffer.
  *****************************************************************************/
 void getRandomName(struct Game *currentGame, char *name) {
-	int i = 0,				// iterator for control structures
-		randomNum = 0;		// random number between 0 and last element in array
-	
-	// generate random number to select from names list
-	randomNum = rand() % currentGame->numNamesRemaining;
-	// copy name from name list at index specified by the random number
-	strcpy(name, currentGame->nameList[randomNum]);
-	// remove the selected name from the list to avoid selecting it again
-	for (i = randomNum; i < currentGame->numNamesRemaining; i++) {
-		strcpy(currentGame->nameList[i], currentGame->nameList[i + 1]);
+	uint64_t start = startStatTimer();
+
+	pickName(&currentGame->namePicker, &currentGame->random, name);
+	stopStatTimer(STAT_PICK_NAME, start);
+}
+
+// longest line formatRouteScore writes, terminator included
+#define ROUTE_SCORE_SIZE 96
+
+/******************************************************************************
+ * Function Name: formatRouteScore
+ * Description: Render the line scoring a route of stepCount steps against
+ *   the shortest one into a ROUTE_SCORE_SIZE buffer: 100 for a shortest
+ *   route, less in proportion to the extra steps. Nothing is written when
+ *   the shortest route is not known. Returns the length of the line.
+ *****************************************************************************/
+static size_t formatRouteScore(char *buffer, int stepCount, int shortestSteps) {
+	if (shortestSteps < 0 || stepCount <= 0) {
+		buffer[0] = '\0';
+		return 0;
+	}
+	return snprintf(buffer, ROUTE_SCORE_SIZE, "THE SHORTEST PATH TAKES %i STEPS. YOUR ROUTE SCORED %i OUT OF 100.\n",
+	                shortestSteps, (int)((long long)shortestSteps * 100 / stepCount));
+}
+
+/******************************************************************************
+ * Function Name: formatGameResults
+ * Description: Render the congratulatory messages, the total steps taken,
+ *   the path traveled from a step list, and, if shortestSteps is not -1, the
+ *   route's score against the shortest one into one new buffer. Returns the
+ *   buffer, which the caller frees, and stores its length.
+ *****************************************************************************/
+char *formatGameResults(const struct World *world, const int *stepList, int stepCount,
+                        int shortestSteps, size_t *length) {
+	size_t capacity = 128 + ROUTE_SCORE_SIZE,
+		   position = 0;
+	char *report;
+	int i = 0;
+
+	// size the report for the messages and one line per step
+	for (i = 0; i < stepCount; i++) {
+		capacity += world->roomList[stepList[i]].nameLength + 1;
+	}
+	report = malloc(capacity);
+	if (report == NULL) {
+		fprintf(stderr, "Could not allocate %zu bytes for the results.\n", capacity);
+		exit(1);
+	}
+	// congratulations, number of steps taken, and path message
+	position = snprintf(report, capacity, "YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n"
+	                    "YOU TOOK %i STEPS. YOUR PATH TO VICTORY WAS: \n", stepCount);
+	// path steps in order
+	for (i = 0; i < stepCount; i++) {
+		const struct Room *room = &world->roomList[stepList[i]];
+		memcpy(report + position, world->namePool + room->nameOffset, room->nameLength);
+		position += room->nameLength;
+		report[position++] = '\n';
+	}
+	// score against the shortest route
+	position += formatRouteScore(report + position, stepCount, shortestSteps);
+	*length = position;
+	return report;
+}
+
+// copy text to a buffer position if it still fits, always advancing past it
+static void appendText(char *buffer, size_t size, size_t *position, const char *text, size_t length) {
+	if (*position + length <= size) {
+		memcpy(buffer + *position, text, length);
+	}
+	*position += length;
+}
+
+/******************************************************************************
+ * Function Name: formatRoomPrompt
+ * Description: Render the current location, its possible connections, and
+ *   the question asked of the player into a buffer of the specified size.
+ *   Like snprintf, returns the full length of the prompt even when the
+ *   buffer is too small to hold it, so the caller can grow the buffer and
+ *   try again. The prompt is not terminated.
+ *****************************************************************************/
+size_t formatRoomPrompt(const struct World *world, int roomIndex, char *buffer, size_t size) {
+	const int *conns = getConns(world, roomIndex);
+	size_t position = 0;
+	int i = 0;
+
+	appendText(buffer, size, &position, "CURRENT LOCATION: ", 18);
+	appendText(buffer, size, &position, getRoomName(world, roomIndex), world->roomList[roomIndex].nameLength);
+	appendText(buffer, size, &position, "\nPOSSIBLE CONNECTIONS: ", 23);
+	for (i = 0; i < getNumConns(world, roomIndex); i++) {
+		if (i > 0) {
+			appendText(buffer, size, &position, ", ", 2);
+		}
+		appendText(buffer, size, &position, getRoomName(world, conns[i]), world->roomList[conns[i]].nameLength);
 	}
-	// decrement the number of names remaining in the list by 1
-	currentGame->numNamesRemaining--;
+	appendText(buffer, size, &position, ".\nWHERE TO? >", 13);
+	return position;
 }
 
 /******************************************************************************
  * Function Name: displayGameResults
  * Description: Display the congratulatory messages to the user including the
- *   total steps taken and the path traveled from start to finish.
+ *   total steps taken, the path traveled from start to finish, and how the
+ *   path compares with the shortest one. The whole report is rendered into
+ *   one buffer from the step list and written to the screen with a single
+ *   write.
  *****************************************************************************/
 void displayGameResults(struct Game *currentGame) {
-	FILE *fp = fopen(currentGame->stepFileName, "r");
-	char c;
-	// display congratulations message
-    printf("YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");
-    // display number of steps taken
-    printf("YOU TOOK %i STEPS. ", currentGame->stepCount);
-    // display path message
-    printf("YOUR PATH TO VICTORY WAS: \n");
+	size_t length,
+		   written = 0;
+	ssize_t nwritten;
+	struct World *world = &currentGame->world;
+	char *report = formatGameResults(world, currentGame->stepList, currentGame->stepCount,
+	                                 findPathDistance(getGameOracle(currentGame), world->startRoomIndex,
+	                                                  world->endRoomIndex), &length);
+
+	// anything printed earlier must reach the screen first
+	fflush(stdout);
+	while (written < length) {
+		nwritten = write(STDOUT_FILENO, report + written, length - written);
+		if (nwritten < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		written += nwritten;
+	}
+	free(report);
+}
+
+/******************************************************************************
+ * Function Name: addGameStep
+ * Description: Append a room to the game's step list, doubling the list in
+ *   the game's arena whenever it is full.
+ *****************************************************************************/
+void addGameStep(struct Game *currentGame, int roomIndex) {
+	if (currentGame->stepCount == currentGame->stepCapacity) {
+		int capacity = currentGame->stepCapacity > 0 ? currentGame->stepCapacity * 2 : 64;
+		currentGame->stepList = growArena(&currentGame->arena, currentGame->stepList,
+		                                  sizeof(int) * currentGame->stepCapacity, sizeof(int) * capacity);
+		currentGame->stepCapacity = capacity;
+	}
+	currentGame->stepList[currentGame->stepCount++] = roomIndex;
+}
+
+/******************************************************************************
+ * Function Name: initGameOptions
+ * Description: Set the world options to the classic game of
+ *   gilesm.config.h: 7 rooms, each with at least 3 and at most 6
+ *   connections, built by whichever engine suits them.
+ *****************************************************************************/
+void initGameOptions(struct GameOptions *options) {
+	options->numRooms = CLASSIC_ROOMS;
+	options->minConn = CLASSIC_MIN_CONN;
+	options->maxConn = CLASSIC_MAX_CONN;
+	options->nameList = NULL;
+	options->engine = ENGINE_AUTO;
+}
+
+/******************************************************************************
+ * Function Name: checkGameOptions
+ * Description: Returns 0 if the options can build a connected world in
+ *   which every room has its fewest connections, or explains the problem on
+ *   stderr and returns -1. A world larger than two rooms needs at least 2
+ *   connections per room to join them all, no room can need a connection to
+ *   every other room and more, and when every room needs exactly as many
+ *   connections as it may have, the rooms must have an even total, since
+ *   each connection has two ends.
+ *****************************************************************************/
+int checkGameOptions(const struct GameOptions *options) {
+	// no room can connect to more rooms than the world has besides itself
+	int maxConn = (options->numRooms - 1 < options->maxConn) ? options->numRooms - 1 : options->maxConn;
+
+	if (options->numRooms < 2) {
+		fprintf(stderr, "A world needs at least 2 rooms.\n");
+		return -1;
+	}
+	if (options->minConn < 1) {
+		fprintf(stderr, "Rooms need at least 1 connection.\n");
+		return -1;
+	}
+	if (options->maxConn < options->minConn) {
+		fprintf(stderr, "The most connections cannot be fewer than the least.\n");
+		return -1;
+	}
+	if (options->maxConn < 2 && options->numRooms > 2) {
+		fprintf(stderr, "Rooms need up to 2 connections to join more than 2 rooms.\n");
+		return -1;
+	}
+	if (options->minConn >= options->numRooms) {
+		fprintf(stderr, "Rooms cannot need %d connections in a world of %d rooms.\n",
+		        options->minConn, options->numRooms);
+		return -1;
+	}
+	if (options->minConn == maxConn && (long long)options->numRooms * options->minConn % 2 != 0) {
+		fprintf(stderr, "%d rooms cannot all have exactly %d connections.\n", options->numRooms, options->minConn);
+		return -1;
+	}
+	if (options->engine == ENGINE_FIXED && !fitsFixedEngine(options)) {
+		if (FIXED_ENGINE) {
+			fprintf(stderr, "The fixed engine only builds worlds of %d rooms with %d to %d connections.\n",
+			        CLASSIC_ROOMS, CLASSIC_MIN_CONN, CLASSIC_MAX_CONN);
+		} else {
+			fprintf(stderr, "This build has no fixed engine.\n");
+		}
+		return -1;
+	}
+	return 0;
+}
 
-    // Read path steps from file and display them in order
-	while ((c = fgetc(fp)) != EOF) {
-		printf("%c", c);
+/******************************************************************************
+ * Function Name: parseGameEngine
+ * Description: Read the name of a world engine as given to --engine.
+ *   Returns 0 on success, or explains and returns -1 for an unknown name.
+ *****************************************************************************/
+int parseGameEngine(const char *name, enum GameEngine *engine) {
+	if (strcmp(name, "auto") == 0) {
+		*engine = ENGINE_AUTO;
+	} else if (strcmp(name, "fixed") == 0) {
+		*engine = ENGINE_FIXED;
+	} else if (strcmp(name, "runtime") == 0) {
+		*engine = ENGINE_RUNTIME;
+	} else {
+		fprintf(stderr, "Unknown engine %s, expected auto, fixed, or runtime.\n", name);
+		return -1;
 	}
+	return 0;
+}
 
-	fclose(fp);
+/******************************************************************************
+ * Function Name: getGameEngineName
+ * Description: Returns the name of a world engine as given to --engine.
+ *****************************************************************************/
+const char *getGameEngineName(enum GameEngine engine) {
+	if (engine == ENGINE_FIXED) {
+		return "fixed";
+	}
+	return engine == ENGINE_RUNTIME ? "runtime" : "auto";
 }
 
 /******************************************************************************
  * Function Name: initGame
- * Description: Initialize the game attributes, room name list, and directory
- *   path.
+ * Description: Initialize the game attributes, room name list, and room list,
+ *   and seed the game's random stream. Every random choice made while the
+ *   world is built comes from that stream, so a seed always builds the same
+ *   world. No files are touched; interactive games follow up with
+ *   initGameDir.
+ *
+ *   Everything the game keeps comes from its arena, whose first block is
+ *   sized for the whole world, and per-room work from a scratch sub-arena
+ *   carved out of it, so building and playing a game takes a handful of heap
+ *   calls however many rooms it has, and freeGame returns them all at once.
  *****************************************************************************/
-void initGame(struct Game *currentGame) {
-	int i = 0,
-		status;
-	char buffer[512];
-	int file_descriptor;
-	
-	// initialize name list with 10 predefined options
-	strcpy(currentGame->nameList[0], "Lila's Room");
-	strcpy(currentGame->nameList[1], "Lila's Cell");
-	strcpy(currentGame->nameList[2], "Mother's Secret Office");
-	strcpy(currentGame->nameList[3], "Kitchen");
-	strcpy(currentGame->nameList[4], "Old Torture Room");
-	strcpy(currentGame->nameList[5], "Rooftop Deck");
-	strcpy(currentGame->nameList[6], "Master Bedroom");
-	strcpy(currentGame->nameList[7], "Dark Closet");
-	strcpy(currentGame->nameList[8], "New Torture Room");
-	strcpy(currentGame->nameList[9], "Dining Room");
-	// all names are remaining initially
-	currentGame->numNamesRemaining = 10;
+void initGame(struct Game *currentGame, const struct GameOptions *options, uint64_t seed) {
+	int numRooms = options->numRooms,
+		maxConn;
+	uint64_t start = startStatTimer();
+
+	// no room can connect to more rooms than the world has besides itself
+	maxConn = (numRooms - 1 < options->maxConn) ? numRooms - 1 : options->maxConn;
+	currentGame->minConn = options->minConn;
+	currentGame->fixedEngine = options->engine != ENGINE_RUNTIME && fitsFixedEngine(options);
+
+	// one block for the world, builder, and names, plus the scratch arena
+	initArena(&currentGame->arena, GAME_SCRATCH_SIZE * 2 + (size_t)numRooms * (112 + 8 * maxConn) +
+	          getRoomMatrixSize(numRooms));
+	initSubArena(&currentGame->scratch, &currentGame->arena, GAME_SCRATCH_SIZE);
+
+	// draw room names from the given dictionary or the classic names
+	initNamePicker(&currentGame->namePicker,
+	               options->nameList != NULL ? options->nameList : getDefaultNameList(), numRooms,
+	               &currentGame->arena);
 
 	// initialize basic parameters
 	currentGame->stepCount = 0;				// number of steps taken
-	currentGame->numNamesRemaining = 10;	// number of names available
-	currentGame->startRoomIndex = -1;		// start room index, -1 is bad
-	currentGame->endRoomIndex = -1;			// end room index, -1 is bad
+	currentGame->stepCapacity = 0;			// step list grows on the first step
+	currentGame->stepList = NULL;
+	currentGame->saveWorld = 0;				// nothing to save until asked
+	currentGame->exportText = 0;			// no text room files until asked
+	currentGame->saveStarted = 0;			// no background save running
+	currentGame->dirPath[0] = '\0';			// no game directory yet
+	currentGame->precomputePaths = 0;		// search for paths as they are asked
+	currentGame->oracle.world = NULL;		// no path oracle until one is used
+	currentGame->traceLog = NULL;			// no game log until asked
+
+	// seed the random stream used to build the world
+	currentGame->seed = seed;
+	seedRandom(&currentGame->random, seed);
+
+	// allocate rooms and connection slots
+	initWorld(&currentGame->world, numRooms, &currentGame->arena);
+	initWorldBuilder(&currentGame->builder, numRooms, maxConn, &currentGame->arena);
 	
 	// randomly select starting room
-	currentGame->startRoomIndex = (rand() % 7);
+	currentGame->world.startRoomIndex = randomBelow(&currentGame->random, numRooms);
 	// randomly select ending room ensuring it is different from start room
 	do {
-		currentGame->endRoomIndex = (rand() % 7);
-	} while (currentGame->startRoomIndex == currentGame->endRoomIndex);
+		currentGame->world.endRoomIndex = randomBelow(&currentGame->random, numRooms);
+	} while (currentGame->world.startRoomIndex == currentGame->world.endRoomIndex);
+	stopStatTimer(STAT_INIT_GAME, start);
+}
 
-	// initialize each room active connections to 0, add connection to self
-	for (i = 0; i < 7; i++) {
-		// 0 initial active connections
-		currentGame->roomList[i].numActiveConn = 0;
-		// establish connection to self, does not add to active connections
-		currentGame->roomList[i].connections[i] = 1;
-	}
+/******************************************************************************
+ * Function Name: initGameDir
+ * Description: Create the per-process game directory and name the world file.
+ *   A directory already there is used as it is; any other failure to create
+ *   it is fatal, before anything is written into it.
+ *****************************************************************************/
+void initGameDir(struct Game *currentGame) {
+	char buffer[512];
 
 	// gather current process id and build directory path for files
 	currentGame->processID = getpid();		// current process ID for program
 	sprintf(buffer,"gilesm.rooms.%d", currentGame->processID); 
 	strcpy(currentGame->dirPath, buffer);
-	// create room file directory
-	status = mkdir(currentGame->dirPath, 0775);
-	// create room files with appropriate permissions
-	for (i = 0; i < 7; i++) {
-		createRoomFile(currentGame, i);
-	}
-	// create step list temporary file
-	sprintf(currentGame->stepFileName, "%s/stepHistory", currentGame->dirPath);
-	file_descriptor = open(currentGame->stepFileName, O_RDONLY | O_CREAT, 0775);
-	if (file_descriptor < 0) {
-		fprintf(stderr, "Could not open %s to create the file.\n", currentGame->stepFileName);
+	// create room file directory, which a reused process ID may have left
+	if (mkdir(currentGame->dirPath, 0775) == -1 && errno != EEXIST) {
+		perror(currentGame->dirPath);
 		exit(1);
 	}
-	close(file_descriptor);
+	// name the binary world file
+	sprintf(currentGame->worldFileName, "%s/world", currentGame->dirPath);
+}
+
+/******************************************************************************
+ * Function Name: freeGame
+ * Description: Release all memory held by a game, waiting first for any
+ *   background save that still reads the world. The world, builder, name
+ *   table, and step list all go back with the game's arena.
+ *****************************************************************************/
+void freeGame(struct Game *currentGame) {
+	finishSaveGame(currentGame);
+	currentGame->stepList = NULL;
+	if (currentGame->oracle.world != NULL) {
+		freePathOracle(&currentGame->oracle);
+	}
+	freeNamePicker(&currentGame->namePicker);
+	freeWorldBuilder(&currentGame->builder);
+	freeWorld(&currentGame->world);
+	// the scratch arena's first block belongs to the game arena
+	freeArena(&currentGame->scratch);
+	freeArena(&currentGame->arena);
+}
+
+/******************************************************************************
+ * Function Name: getGameOracle
+ * Description: Returns the shortest path oracle of the game's world,
+ *   preparing it the first time it is asked for, with every distance to the
+ *   end room recorded up front if the game was set to precompute paths.
+ *****************************************************************************/
+struct PathOracle *getGameOracle(struct Game *currentGame) {
+	if (currentGame->oracle.world == NULL) {
+		initPathOracle(&currentGame->oracle, &currentGame->world, currentGame->precomputePaths);
+	}
+	return &currentGame->oracle;
 }
 
 /******************************************************************************
  * Function Name: playGame
  * Description: Allow the player to play game until end room is reached.
+ *   Typing "hint" instead of a room name shows a connected room that lies on
+ *   a shortest path to the end room without taking a step. Commands are
+ *   read and the screen written through a console, so every command already
+ *   queued on the input is played before the screen is written once.
  *****************************************************************************/
 void playGame(struct Game *currentGame) {
-	int currentLocation = currentGame->startRoomIndex,
+	struct World *world = &currentGame->world;
+	struct Console console;
+	int currentLocation = world->startRoomIndex,
 		i = 0,
-		count = 0,
-		success = 0,
-		file_descriptor;
-	char buffer[50];
-	char *fileName = malloc(sizeof(char) * 25);
-	char *historyName = malloc(sizeof(char) * 50);
-	ssize_t nwritten;
-	// open step history file for writing
-	file_descriptor = open(currentGame->stepFileName, O_RDWR);
-	if (file_descriptor == -1) {
-		fprintf(stderr, "Could not open %s to write to file.\n", fileName);
-		exit(1);
+		success = 0;
+	size_t promptSize = 256,
+		   promptLength,
+		   commandLength;
+	char *command;
+	uint64_t moveStart = 0;
+
+	// anything printed earlier must reach the screen first
+	fflush(stdout);
+	initConsole(&console, STDIN_FILENO, STDOUT_FILENO);
+
+	if (currentGame->traceLog != NULL) {
+		beginTraceRecord(currentGame->traceLog, world, currentGame->seed, currentGame->minConn,
+		                 currentGame->builder.maxConn);
 	}
 	// allow player to move through connected rooms until end room is reached
-	while (currentLocation != currentGame->endRoomIndex) {
-		// allows different formatting for first connection
-		count = 0;
+	while (currentLocation != world->endRoomIndex) {
 		// determines if user typed appropriate connection room name
 		success = 0;
-		// shows room name for current room
-		printf("CURRENT LOCATION: %s\n", currentGame->roomList[currentLocation].name);
-		// displays room name for all connected rooms
-		printf("POSSIBLE CONNECTIONS: ");
-		for (i = 0; i < 7; i++) {
-			if (currentGame->roomList[currentLocation].connections[i] == 1 && currentLocation != i) {
-				if (count == 0) {
-					printf("%s", currentGame->roomList[i].name);
-					count++;
-				} else {
-					printf(", %s", currentGame->roomList[i].name);
-				}
+		// shows room name for current room and for all connected rooms
+		while ((promptLength = formatRoomPrompt(world, currentLocation, reserveConsole(&console, promptSize),
+		                                        promptSize)) > promptSize) {
+			promptSize = promptLength;
+		}
+		commitConsole(&console, promptLength);
+		// a move lasts from its input until the next prompt is out
+		stopStatTimer(STAT_MOVE, moveStart);
+		// gets user input for room selection, stopping if input has ended
+		if ((command = readConsoleLine(&console, &commandLength)) == NULL) {
+			freeConsole(&console);
+			fprintf(stderr, "No more input, leaving the game.\n");
+			exit(1);
+		}
+		moveStart = startStatTimer();
+		// looks up the typed room by name and checks it is connected here
+		i = findRoom(world, command, commandLength);
+		if (i != -1 && isConnected(world, currentLocation, i)) {
+			currentLocation = i;
+			// stores room for history and increments total step count
+			addGameStep(currentGame, currentLocation);
+			if (currentGame->traceLog != NULL) {
+				addTraceStep(currentGame->traceLog, currentLocation);
 			}
+			// indicates user typed successful connecting room name
+			success = 1;
 		}
-		printf(".\n");
-		printf("WHERE TO? >");
-		// gets user input for room selection
-		fgets(buffer, 50, stdin);
-		// terminates string with null character
-		buffer[strlen(buffer) - 1] = '\0';
-		// reads through each room to retrieve room names
-		for (i = 0; i < 7; i++) {
-			if (currentGame->roomList[currentLocation].connections[i] == 1 && currentLocation != i) {
-				if (strcmp(currentGame->roomList[i].name, buffer) == 0) {
-					currentLocation = i;
-					sprintf(historyName, "%s\n", currentGame->roomList[i].name);
-					// stores room name for history
-					nwritten = write(file_descriptor, historyName, strlen(historyName));
-					// increments total step count
-					currentGame->stepCount++;
-					// indicates user typed successful connecting room name
-					success = 1;
-				}
+		writeConsole(&console, "\n", 1);
+		if (success == 0 && strcmp(command, "hint") == 0 &&
+		    (i = findNextRoom(getGameOracle(currentGame), currentLocation)) != -1) {
+			// names the next room of a shortest path
+			writeConsole(&console, "HINT: TRY ", 10);
+			writeConsole(&console, getRoomName(world, i), world->roomList[i].nameLength);
+			writeConsole(&console, ".\n\n", 3);
+		} else if (success == 0) {
+			countStat(STAT_UNKNOWN_ROOMS, 1);
+			writeConsole(&console, "HUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n", 47);
+		}
+	}
+	stopStatTimer(STAT_MOVE, moveStart);
+	freeConsole(&console);
+	if (currentGame->traceLog != NULL) {
+		endTraceRecord(currentGame->traceLog);
+	}
+}
+
+// grow a buffer in an arena so it holds at least the specified number of bytes
+static char *growText(struct Arena *arena, char *buffer, size_t *size, size_t needed) {
+	size_t oldSize = *size;
+
+	if (needed > *size) {
+		while (*size < needed) {
+			*size *= 2;
+		}
+		buffer = growArena(arena, buffer, oldSize, *size);
+	}
+	return buffer;
+}
+
+/******************************************************************************
+ * Function Name: playCachedGame
+ * Description: Play like playGame, but read rooms through a room cache
+ *   instead of from a world held in memory. Each prompt fetches the current
+ *   room and its neighbors, and the player's answer is matched against the
+ *   neighbor names just printed, so only rooms next to the player are ever
+ *   read. The screen shows exactly what playGame would show, through a
+ *   console in the same way, except that "hint" is answered with a message
+ *   that hints are not available: finding a shortest path needs the whole
+ *   world, which a lazily read or streaming world never has in memory.
+ *****************************************************************************/
+void playCachedGame(struct Game *currentGame, struct RoomCache *cache) {
+	const struct RoomRecord *record;
+	struct Console console;
+	int currentLocation = cache->source->startRoomIndex,
+		numConns = 0,
+		connCapacity = 16,
+		*conns = allocArena(&currentGame->arena, sizeof(int) * connCapacity),
+		*nameStarts = allocArena(&currentGame->arena, sizeof(int) * (connCapacity + 1)),
+		i = 0,
+		success = 0;
+	size_t promptSize = 256,
+		   promptLength,
+		   commandLength;
+	char *command,
+		 *prompt = allocArena(&currentGame->arena, promptSize);
+	uint64_t moveStart = 0;
+
+	// anything printed earlier must reach the screen first
+	fflush(stdout);
+	initConsole(&console, STDIN_FILENO, STDOUT_FILENO);
+
+	// allow player to move through connected rooms until end room is reached
+	while (currentLocation != cache->source->endRoomIndex) {
+		// determines if user typed appropriate connection room name
+		success = 0;
+		// keep the current room's connections, its record may be evicted
+		record = getCachedRoom(cache, currentLocation);
+		if (record == NULL) {
+			fprintf(stderr, "Could not read room %d.\n", currentLocation);
+			exit(1);
+		}
+		if (record->numConns > connCapacity) {
+			connCapacity = record->numConns;
+			conns = allocArena(&currentGame->arena, sizeof(int) * connCapacity);
+			nameStarts = allocArena(&currentGame->arena, sizeof(int) * (connCapacity + 1));
+		}
+		numConns = record->numConns;
+		memcpy(conns, record->conns, sizeof(int) * numConns);
+		// shows room name for current room and for all connected rooms,
+		// remembering where each connected name starts in the prompt
+		prompt = growText(&currentGame->arena, prompt, &promptSize, 18 + record->nameLength + 23 + 13);
+		promptLength = 0;
+		appendText(prompt, promptSize, &promptLength, "CURRENT LOCATION: ", 18);
+		appendText(prompt, promptSize, &promptLength, record->name, record->nameLength);
+		appendText(prompt, promptSize, &promptLength, "\nPOSSIBLE CONNECTIONS: ", 23);
+		for (i = 0; i < numConns; i++) {
+			record = getCachedRoom(cache, conns[i]);
+			if (record == NULL) {
+				fprintf(stderr, "Could not read room %d.\n", conns[i]);
+				exit(1);
 			}
+			prompt = growText(&currentGame->arena, prompt, &promptSize, promptLength + 2 + record->nameLength + 13);
+			if (i > 0) {
+				appendText(prompt, promptSize, &promptLength, ", ", 2);
+			}
+			nameStarts[i] = promptLength;
+			appendText(prompt, promptSize, &promptLength, record->name, record->nameLength);
 		}
-		printf("\n");
-		if (success == 0) {
-			printf("HUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n");
-			printf("\n");
+		nameStarts[numConns] = promptLength + 2;
+		appendText(prompt, promptSize, &promptLength, ".\nWHERE TO? >", 13);
+		writeConsole(&console, prompt, promptLength);
+		// a move lasts from its input until the next prompt is out
+		stopStatTimer(STAT_MOVE, moveStart);
+		// gets user input for room selection, stopping if input has ended
+		if ((command = readConsoleLine(&console, &commandLength)) == NULL) {
+			freeConsole(&console);
+			fprintf(stderr, "No more input, leaving the game.\n");
+			exit(1);
+		}
+		moveStart = startStatTimer();
+		// looks up the typed room among the connected names
+		for (i = 0; i < numConns; i++) {
+			if ((size_t)(nameStarts[i + 1] - 2 - nameStarts[i]) == commandLength &&
+			    memcmp(prompt + nameStarts[i], command, commandLength) == 0) {
+				currentLocation = conns[i];
+				// stores room for history and increments total step count
+				addGameStep(currentGame, currentLocation);
+				// indicates user typed successful connecting room name
+				success = 1;
+				break;
+			}
+		}
+		writeConsole(&console, "\n", 1);
+		if (success == 0 && strcmp(command, "hint") == 0) {
+			// no oracle without the whole world in memory
+			writeConsole(&console, "HINT: NOT AVAILABLE WHILE ROOMS ARE READ ON DEMAND.\n\n", 53);
+		} else if (success == 0) {
+			countStat(STAT_UNKNOWN_ROOMS, 1);
+			writeConsole(&console, "HUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n", 47);
 		}
 	}
-	close(file_descriptor);
+	stopStatTimer(STAT_MOVE, moveStart);
+	freeConsole(&console);
+}
+
+/******************************************************************************
+ * Function Name: displayCachedResults
+ * Description: Display the results of a game played with playCachedGame,
+ *   reading the names along the path through the room cache, and scored
+ *   against shortestSteps unless it is -1. The report matches
+ *   displayGameResults and is written with a single write.
+ *****************************************************************************/
+void displayCachedResults(struct Game *currentGame, struct RoomCache *cache, int shortestSteps) {
+	const struct RoomRecord *record;
+	size_t size = 256,
+		   length,
+		   written = 0;
+	ssize_t nwritten;
+	char *report = allocArena(&currentGame->arena, size);
+	int i = 0;
+
+	// congratulations, number of steps taken, and path message
+	length = snprintf(report, size, "YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n"
+	                  "YOU TOOK %i STEPS. YOUR PATH TO VICTORY WAS: \n", currentGame->stepCount);
+	// path steps in order
+	for (i = 0; i < currentGame->stepCount; i++) {
+		record = getCachedRoom(cache, currentGame->stepList[i]);
+		if (record == NULL) {
+			fprintf(stderr, "Could not read room %d.\n", currentGame->stepList[i]);
+			exit(1);
+		}
+		report = growText(&currentGame->arena, report, &size, length + record->nameLength + 1);
+		memcpy(report + length, record->name, record->nameLength);
+		length += record->nameLength;
+		report[length++] = '\n';
+	}
+	// score against the shortest route
+	report = growText(&currentGame->arena, report, &size, length + ROUTE_SCORE_SIZE);
+	length += formatRouteScore(report + length, currentGame->stepCount, shortestSteps);
+
+	// anything printed earlier must reach the screen first
+	fflush(stdout);
+	while (written < length) {
+		nwritten = write(STDOUT_FILENO, report + written, length - written);
+		if (nwritten < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+		written += nwritten;
+	}
 }
@@ -0,0 +1,123 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.adventure.h
+ * Description: Game state and the game functions implemented in
+ *   gilesm.adventure.c, shared with the other modes of the program.
+ *****************************************************************************/
+#ifndef GILESM_ADVENTURE_H
+#define GILESM_ADVENTURE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "gilesm.world.h"
+#include "gilesm.random.h"
+#include "gilesm.names.h"
+#include "gilesm.roomcache.h"
+#include "gilesm.oracle.h"
+#include "gilesm.arena.h"
+#include "gilesm.tracelog.h"
+
+#define GAME_SCRATCH_SIZE 4096			// first block of a game's scratch arena
+
+enum GameEngine {
+	ENGINE_AUTO,						// fixed engine for classic worlds, runtime otherwise
+	ENGINE_FIXED,						// fixed engine, only for classic worlds
+	ENGINE_RUNTIME						// runtime-sized engine for every world
+};
+
+struct GameOptions {
+	int numRooms;						// number of rooms in each world
+	int minConn;						// fewest connections a room may have
+	int maxConn;						// most connections a room may have
+	const struct NameList *nameList;	// room names, NULL for the classic ones
+	enum GameEngine engine;				// engine that builds the worlds
+};
+
+struct Game {
+	struct Arena arena;					// memory for everything the game keeps
+	struct Arena scratch;				// memory for one room's work, reset after it
+	struct World world;					// rooms and connections for this game
+	struct WorldBuilder builder;		// connections while rooms are built
+	uint64_t seed;						// seed the world was generated from
+	struct Random random;				// random stream for world generation
+	struct NamePicker namePicker;		// draws unique room names
+	int minConn;						// fewest connections a room may have
+	int fixedEngine;					// built by the fixed engine of gilesm.fixed.h
+	int stepCount;						// tracks number of steps taken
+	int stepCapacity;					// rooms stepList has space for
+	int *stepList;						// room index of every step, in order
+	int processID;						// process ID of current game
+	char dirPath[512];					// path of directory for files
+	char worldFileName[512];			// name of binary world file
+	int saveWorld;						// write the binary world file
+	int exportText;						// write text room files for debugging
+	int saveStarted;					// background save thread is running
+	pthread_t saveThread;				// thread writing the world to disk
+	int precomputePaths;				// record every distance to the end up front
+	struct PathOracle oracle;			// shortest paths, world is NULL until used
+	struct TraceLog *traceLog;			// shared log the game is recorded in, or NULL
+};
+
+// set the classic options of gilesm.config.h: 7 rooms with 3 to 6 connections each
+void initGameOptions(struct GameOptions *options);
+// returns 0 if the options can build a world, otherwise explains and returns -1
+int checkGameOptions(const struct GameOptions *options);
+// parse "auto", "fixed", or "runtime", returns 0 on success or -1
+int parseGameEngine(const char *name, enum GameEngine *engine);
+// name of a world engine as given to --engine
+const char *getGameEngineName(enum GameEngine engine);
+// connect every room into one region with a random spanning tree
+void addSpanningConns(struct Game *currentGame);
+// takes a game structure, a room index, and adds a connection to that room
+int addRoomConn(struct Game *currentGame, int roomIndex);
+// rewire other rooms' connections to give a room more, returns 0 if none can be
+int repairRoomConn(struct Game *currentGame, int roomIndex);
+// assign room names, room connections, and save room files to directory
+void buildGame(struct Game *currentGame);
+// text of a room's file, formatted in an arena, with its length stored
+char *formatRoomFile(const struct World *world, int roomNumber, struct Arena *arena, size_t *length);
+// populate room files with description/information for a specified room number
+void writeRoomFile(struct Game *currentGame, int roomNumber);
+// read room file text already in memory into local structure for a specified room number
+void parseRoomFile(struct Game *currentGame, int roomNumber, char *text, size_t length);
+// read room file contents into local structure for a specified room number
+void readRoomFile(struct Game *currentGame, int roomNumber);
+// create a room file for the game with a specified file number.
+void createRoomFile(struct Game *currentGame, int roomNumber);
+// write every room to its own text file for debugging
+void exportRoomFiles(struct Game *currentGame);
+// replace the game's world with one mapped from a binary world file
+void loadGame(struct Game *currentGame, const char *fileName);
+// play a world published in shared memory instead of building one
+void attachGame(struct Game *currentGame, const char *shmName);
+// start writing the requested world files on a background thread
+void saveGame(struct Game *currentGame);
+// wait for the background save started by saveGame to finish
+void finishSaveGame(struct Game *currentGame);
+// Display the congratulatory messages to the user
+void displayGameResults(struct Game *currentGame);
+// render the results of a won game into a new buffer, storing its length
+char *formatGameResults(const struct World *world, const int *stepList, int stepCount,
+                        int shortestSteps, size_t *length);
+// render a room's prompt into a buffer, returns its length even if it did not fit
+size_t formatRoomPrompt(const struct World *world, int roomIndex, char *buffer, size_t size);
+// record a move to the specified room in the game's step list
+void addGameStep(struct Game *currentGame, int roomIndex);
+// copy a random name not yet used in this world into a ROOM_NAME_SIZE buffer
+void getRandomName(struct Game *currentGame, char *name);
+// initialize the game attributes, room name list, room list, and random seed
+void initGame(struct Game *currentGame, const struct GameOptions *options, uint64_t seed);
+// create the game directory and the name of its world file
+void initGameDir(struct Game *currentGame);
+// release all memory held by a game
+void freeGame(struct Game *currentGame);
+// allow player to play game until end room is reached
+void playGame(struct Game *currentGame);
+// play like playGame, reading rooms on demand through a room cache
+void playCachedGame(struct Game *currentGame, struct RoomCache *cache);
+// display the results of a game played with playCachedGame
+void displayCachedResults(struct Game *currentGame, struct RoomCache *cache, int shortestSteps);
+// shortest path oracle of the game's world, prepared on first use
+struct PathOracle *getGameOracle(struct Game *currentGame);
+
+#endif
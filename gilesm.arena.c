@@ -0,0 +1,173 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.arena.c
+ * Description: Arena allocator described in gilesm.arena.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gilesm.arena.h"
+
+// bytes before a block's memory, rounded so the memory stays aligned
+#define ARENA_HEADER_SIZE ((sizeof(struct ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// first byte of a block's memory
+static char *getBlockMemory(struct ArenaBlock *block) {
+	return (char *)block + ARENA_HEADER_SIZE;
+}
+
+// round a size up to the allocation boundary
+static size_t alignArenaSize(size_t size) {
+	return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+/******************************************************************************
+ * Function Name: initArena
+ * Description: Prepare an empty arena. No memory is taken until the first
+ *   allocation, and then in blocks of at least blockSize bytes.
+ *****************************************************************************/
+void initArena(struct Arena *arena, size_t blockSize) {
+	arena->first = NULL;
+	arena->current = NULL;
+	arena->blockSize = blockSize > ARENA_HEADER_SIZE * 4 ? blockSize : ARENA_HEADER_SIZE * 4;
+	arena->last = NULL;
+	arena->numBytes = 0;
+}
+
+/******************************************************************************
+ * Function Name: initSubArena
+ * Description: Prepare an arena whose first block is carved out of a parent
+ *   arena, so it costs no heap call of its own. The block lives as long as
+ *   the parent's allocations do. If the sub-arena outgrows it, later blocks
+ *   come from the heap as in any other arena.
+ *****************************************************************************/
+void initSubArena(struct Arena *arena, struct Arena *parent, size_t size) {
+	struct ArenaBlock *block;
+
+	initArena(arena, size);
+	size = alignArenaSize(size);
+	block = allocArena(parent, ARENA_HEADER_SIZE + size);
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	block->borrowed = 1;
+	arena->first = block;
+	arena->current = block;
+}
+
+/******************************************************************************
+ * Function Name: allocArena
+ * Description: Returns aligned memory for size bytes from the current block.
+ *   When it does not fit, the next kept block large enough is used, and
+ *   failing that a new block of at least blockSize bytes is taken from the
+ *   heap. Exits if the heap is exhausted.
+ *****************************************************************************/
+void *allocArena(struct Arena *arena, size_t size) {
+	struct ArenaBlock *block = arena->current,
+					  *previous = NULL;
+	size_t blockSize;
+	void *memory;
+
+	size = alignArenaSize(size > 0 ? size : 1);
+	if (block == NULL || block->used + size > block->size) {
+		// move on to a later block kept from before a reset
+		previous = block;
+		for (block = block != NULL ? block->next : arena->first; block != NULL; block = block->next) {
+			if (block->used == 0 && size <= block->size) {
+				break;
+			}
+			previous = block;
+		}
+		if (block == NULL) {
+			blockSize = size > arena->blockSize ? size : arena->blockSize;
+			block = malloc(ARENA_HEADER_SIZE + blockSize);
+			if (block == NULL) {
+				fprintf(stderr, "Could not allocate an arena block of %zu bytes.\n", blockSize);
+				exit(1);
+			}
+			block->size = blockSize;
+			block->used = 0;
+			block->borrowed = 0;
+			block->next = NULL;
+			// keep the list in the order blocks are used
+			if (previous != NULL) {
+				block->next = previous->next;
+				previous->next = block;
+			} else {
+				arena->first = block;
+			}
+		}
+		arena->current = block;
+	}
+	memory = getBlockMemory(block) + block->used;
+	block->used += size;
+	arena->numBytes += size;
+	arena->last = memory;
+	return memory;
+}
+
+/******************************************************************************
+ * Function Name: growArena
+ * Description: Returns memory for newSize bytes holding the first oldSize
+ *   bytes of an earlier allocation. The most recent allocation grows in
+ *   place while its block has room; anything else is copied to a new
+ *   allocation and its old memory stays unused until the next reset.
+ *****************************************************************************/
+void *growArena(struct Arena *arena, void *memory, size_t oldSize, size_t newSize) {
+	struct ArenaBlock *block = arena->current;
+	size_t start;
+	void *grown;
+
+	if (memory == NULL) {
+		return allocArena(arena, newSize);
+	}
+	if (memory == arena->last) {
+		start = (char *)memory - getBlockMemory(block);
+		if (start + alignArenaSize(newSize) <= block->size) {
+			arena->numBytes += alignArenaSize(newSize) - (block->used - start);
+			block->used = start + alignArenaSize(newSize);
+			return memory;
+		}
+	}
+	grown = allocArena(arena, newSize);
+	memcpy(grown, memory, oldSize < newSize ? oldSize : newSize);
+	return grown;
+}
+
+/******************************************************************************
+ * Function Name: resetArena
+ * Description: Release every allocation at once. The blocks are kept and
+ *   reused by later allocations.
+ *****************************************************************************/
+void resetArena(struct Arena *arena) {
+	struct ArenaBlock *block;
+
+	for (block = arena->first; block != NULL; block = block->next) {
+		block->used = 0;
+	}
+	arena->current = arena->first;
+	arena->last = NULL;
+	arena->numBytes = 0;
+}
+
+/******************************************************************************
+ * Function Name: freeArena
+ * Description: Return every block taken from the heap and leave the arena
+ *   empty. A block borrowed from a parent arena goes back with the parent.
+ *****************************************************************************/
+void freeArena(struct Arena *arena) {
+	struct ArenaBlock *block = arena->first,
+					  *next;
+
+	while (block != NULL) {
+		next = block->next;
+		if (!block->borrowed) {
+			free(block);
+		}
+		block = next;
+	}
+	arena->first = NULL;
+	arena->current = NULL;
+	arena->last = NULL;
+	arena->numBytes = 0;
+}
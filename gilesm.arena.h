@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.arena.h
+ * Description: Arena allocator. An arena hands out memory by advancing
+ *   through large blocks and never frees single allocations; everything it
+ *   gave out is released at once when it is reset or freed. Memory with a
+ *   common lifetime, such as everything one game allocates, then costs a few
+ *   block allocations instead of one heap call per array or buffer, and
+ *   cannot leak piecemeal.
+ *
+ *   Resetting an arena keeps its blocks for reuse, so a scratch arena that
+ *   is reset after every room it formats stops touching the heap once its
+ *   blocks are large enough. A sub-arena takes its first block out of a
+ *   parent arena and only goes to the heap if it outgrows it.
+ *
+ *   An arena is not locked; each one must be used by one thread at a time.
+ *****************************************************************************/
+#ifndef GILESM_ARENA_H
+#define GILESM_ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 16				// every allocation starts on this boundary
+
+struct ArenaBlock {
+	struct ArenaBlock *next;			// next block, or NULL
+	size_t size;						// bytes of memory after the header
+	size_t used;						// bytes handed out from this block
+	int borrowed;						// taken from a parent arena, not the heap
+};
+
+struct Arena {
+	struct ArenaBlock *first;			// oldest block, or NULL
+	struct ArenaBlock *current;			// block allocations come from
+	size_t blockSize;					// smallest block taken from the heap
+	void *last;							// most recent allocation, or NULL
+	size_t numBytes;					// bytes handed out since the last reset
+};
+
+// prepare an empty arena whose heap blocks are at least blockSize bytes
+void initArena(struct Arena *arena, size_t blockSize);
+// prepare an arena whose first block of size bytes comes from a parent arena
+void initSubArena(struct Arena *arena, struct Arena *parent, size_t size);
+// aligned memory for size bytes, valid until the arena is reset or freed
+void *allocArena(struct Arena *arena, size_t size);
+// resize an allocation, in place if it was the most recent one, else by copy
+void *growArena(struct Arena *arena, void *memory, size_t oldSize, size_t newSize);
+// release every allocation at once, keeping the blocks for reuse
+void resetArena(struct Arena *arena);
+// return every block taken from the heap
+void freeArena(struct Arena *arena);
+
+#endif
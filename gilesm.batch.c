@@ -0,0 +1,387 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.batch.c
+ * Description: Headless batch mode and the move policies described in
+ *   gilesm.batch.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gilesm.adventure.h"
+#include "gilesm.batch.h"
+
+/******************************************************************************
+ * Function Name: randomNextMove
+ * Description: Move to a connected room chosen uniformly at random.
+ *****************************************************************************/
+static int randomNextMove(struct Player *player, int currentRoom) {
+	int numConns = getNumConns(player->world, currentRoom);
+
+	if (numConns == 0) {
+		return MOVE_QUIT;
+	}
+	return getConns(player->world, currentRoom)[randomBelow(&player->random, numConns)];
+}
+
+/******************************************************************************
+ * Function Name: greedyStartGame
+ * Description: Allocate the visit counts used by the greedy policy and count
+ *   the starting room as visited.
+ *****************************************************************************/
+static void greedyStartGame(struct Player *player) {
+	player->visitCount = calloc(player->world->numRooms, sizeof(int));
+	if (player->visitCount == NULL) {
+		fprintf(stderr, "Could not allocate visit counts.\n");
+		exit(1);
+	}
+	player->visitCount[player->world->startRoomIndex] = 1;
+}
+
+/******************************************************************************
+ * Function Name: greedyNextMove
+ * Description: Move to the connected room visited the fewest times so far,
+ *   choosing at random between rooms that tie.
+ *****************************************************************************/
+static int greedyNextMove(struct Player *player, int currentRoom) {
+	const int *conns = getConns(player->world, currentRoom);
+	int numConns = getNumConns(player->world, currentRoom),
+		bestRoom = MOVE_QUIT,
+		numTied = 0,
+		i = 0;
+
+	for (i = 0; i < numConns; i++) {
+		if (bestRoom == MOVE_QUIT || player->visitCount[conns[i]] < player->visitCount[bestRoom]) {
+			bestRoom = conns[i];
+			numTied = 1;
+		} else if (player->visitCount[conns[i]] == player->visitCount[bestRoom] &&
+		           randomBelow(&player->random, ++numTied) == 0) {
+			bestRoom = conns[i];
+		}
+	}
+	if (bestRoom != MOVE_QUIT) {
+		player->visitCount[bestRoom]++;
+	}
+	return bestRoom;
+}
+
+/******************************************************************************
+ * Function Name: greedyEndGame
+ * Description: Release the visit counts used by the greedy policy.
+ *****************************************************************************/
+static void greedyEndGame(struct Player *player) {
+	free(player->visitCount);
+	player->visitCount = NULL;
+}
+
+/******************************************************************************
+ * Function Name: bfsStartGame
+ * Description: Prepare a path oracle with every room's distance to the
+ *   ending room recorded, so each move is a scan of the current room.
+ *****************************************************************************/
+static void bfsStartGame(struct Player *player) {
+	initPathOracle(&player->oracle, player->world, 1);
+}
+
+/******************************************************************************
+ * Function Name: bfsNextMove
+ * Description: Move to the neighbor one step closer to the ending room.
+ *****************************************************************************/
+static int bfsNextMove(struct Player *player, int currentRoom) {
+	int nextRoom = findNextRoom(&player->oracle, currentRoom);
+
+	return nextRoom == -1 ? MOVE_QUIT : nextRoom;
+}
+
+/******************************************************************************
+ * Function Name: bfsEndGame
+ * Description: Release the path oracle used by the bfs policy.
+ *****************************************************************************/
+static void bfsEndGame(struct Player *player) {
+	freePathOracle(&player->oracle);
+}
+
+/******************************************************************************
+ * Function Name: replayStartGame
+ * Description: Start typing from the first line of the script.
+ *****************************************************************************/
+static void replayStartGame(struct Player *player) {
+	player->scriptPosition = 0;
+}
+
+/******************************************************************************
+ * Function Name: replayNextMove
+ * Description: Type the next room name of the script, looked up through the
+ *   world's name index.
+ *****************************************************************************/
+static int replayNextMove(struct Player *player, int currentRoom) {
+	int roomIndex;
+
+	if (player->script == NULL || player->scriptPosition >= player->script->numLines) {
+		return MOVE_QUIT;
+	}
+	roomIndex = findRoom(player->world, player->script->lines[player->scriptPosition],
+	                     player->script->lineLengths[player->scriptPosition]);
+	player->scriptPosition++;
+	return roomIndex == -1 ? MOVE_UNKNOWN : roomIndex;
+}
+
+// every policy that --policy can name
+static const struct MovePolicy movePolicies[] = {
+	{ "random", NULL, randomNextMove, NULL },
+	{ "greedy", greedyStartGame, greedyNextMove, greedyEndGame },
+	{ "bfs", bfsStartGame, bfsNextMove, bfsEndGame },
+	{ "replay", replayStartGame, replayNextMove, NULL }
+};
+
+/******************************************************************************
+ * Function Name: findMovePolicy
+ * Description: Returns the move policy with the specified name, or NULL if no
+ *   policy has that name.
+ *****************************************************************************/
+const struct MovePolicy *findMovePolicy(const char *name) {
+	size_t i = 0;
+
+	for (i = 0; i < sizeof(movePolicies) / sizeof(movePolicies[0]); i++) {
+		if (strcmp(movePolicies[i].name, name) == 0) {
+			return &movePolicies[i];
+		}
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Function Name: loadScript
+ * Description: Read a whole script file and split it into room names, one per
+ *   line. Carriage returns before a newline are dropped. Returns 0 on success
+ *   or -1 if the file cannot be read.
+ *****************************************************************************/
+int loadScript(struct Script *script, const char *fileName) {
+	FILE *fp = fopen(fileName, "r");
+	long length;
+	char *line,
+		 *end;
+	int capacity = 64;
+
+	memset(script, 0, sizeof(*script));
+	if (fp == NULL) {
+		fprintf(stderr, "Could not open %s to read the script.\n", fileName);
+		return -1;
+	}
+	// read the whole file at once
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	script->text = malloc(length + 1);
+	script->lines = malloc(sizeof(char *) * capacity);
+	script->lineLengths = malloc(sizeof(int) * capacity);
+	if (script->text == NULL || script->lines == NULL || script->lineLengths == NULL ||
+	    fread(script->text, 1, length, fp) != (size_t)length) {
+		fprintf(stderr, "Could not read %s.\n", fileName);
+		fclose(fp);
+		freeScript(script);
+		return -1;
+	}
+	fclose(fp);
+	script->text[length] = '\0';
+
+	// record where each line starts and how long it is
+	for (line = script->text; line < script->text + length; line = end + 1) {
+		end = memchr(line, '\n', script->text + length - line);
+		if (end == NULL) {
+			end = script->text + length;
+		}
+		*end = '\0';
+		if (end > line && end[-1] == '\r') {
+			end[-1] = '\0';
+		}
+		if (script->numLines == capacity) {
+			capacity *= 2;
+			script->lines = realloc(script->lines, sizeof(char *) * capacity);
+			script->lineLengths = realloc(script->lineLengths, sizeof(int) * capacity);
+			if (script->lines == NULL || script->lineLengths == NULL) {
+				fprintf(stderr, "Could not allocate %d script lines.\n", capacity);
+				exit(1);
+			}
+		}
+		script->lines[script->numLines] = line;
+		script->lineLengths[script->numLines] = strlen(line);
+		script->numLines++;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: freeScript
+ * Description: Release all memory held by a script.
+ *****************************************************************************/
+void freeScript(struct Script *script) {
+	free(script->text);
+	free(script->lines);
+	free(script->lineLengths);
+	memset(script, 0, sizeof(*script));
+}
+
+/******************************************************************************
+ * Function Name: playHeadless
+ * Description: Play one game with the given policy and no terminal output.
+ *   Each command the policy gives is handled like a typed room name: a
+ *   connected room is a step, anything else is ignored. Returns the number of
+ *   steps taken, or -1 if the policy quit or maxMoves commands were given
+ *   before the end room was reached. The number of commands is stored in
+ *   numCommands, and each step is added to the trace log's open record if
+ *   a log is given.
+ *****************************************************************************/
+long playHeadless(const struct World *world, const struct MovePolicy *policy,
+                  struct Player *player, long maxMoves, long *numCommands, struct TraceLog *traceLog) {
+	int currentLocation = world->startRoomIndex,
+		nextRoom;
+	long stepCount = 0;
+
+	*numCommands = 0;
+	player->world = world;
+	if (policy->startGame != NULL) {
+		policy->startGame(player);
+	}
+	while (currentLocation != world->endRoomIndex && *numCommands < maxMoves) {
+		nextRoom = policy->nextMove(player, currentLocation);
+		if (nextRoom == MOVE_QUIT) {
+			break;
+		}
+		(*numCommands)++;
+		if (nextRoom >= 0 && isConnected(world, currentLocation, nextRoom)) {
+			currentLocation = nextRoom;
+			stepCount++;
+			if (traceLog != NULL) {
+				addTraceStep(traceLog, currentLocation);
+			}
+		}
+	}
+	if (policy->endGame != NULL) {
+		policy->endGame(player);
+	}
+	return currentLocation == world->endRoomIndex ? stepCount : -1;
+}
+
+// seconds elapsed on the monotonic clock
+static double getSeconds(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/******************************************************************************
+ * Function Name: runBatch
+ * Description: Play every game of a batch and print one line per game,
+ *   with the length of the shortest route for comparison, followed by totals
+ *   and throughput. Each game builds a fresh world with
+ *   initGame and buildGame unless a world file was given, in which case every
+ *   game is played on that one world. Game k is seeded with stream k of the
+ *   batch seed, and its player with a jumped copy of that stream, so a game
+ *   can be reproduced on its own. With a trace log name every game is also
+ *   recorded in that log. Returns the process exit status.
+ *****************************************************************************/
+int runBatch(const struct BatchConfig *config) {
+	const struct MovePolicy *policy = findMovePolicy(config->policyName);
+	struct Script script;
+	struct Player player;
+	struct TraceLog traceLog;
+	struct Game *currentGame = malloc(sizeof(struct Game));
+	double startTime,
+		   buildSeconds = 0,
+		   playSeconds = 0,
+		   markTime;
+	long steps,
+		 numCommands,
+		 totalSteps = 0,
+		 totalShortest = 0,
+		 totalCommands = 0;
+	int gameNumber = 0,
+		numFinished = 0,
+		shortest;
+
+	if (policy == NULL) {
+		fprintf(stderr, "Unknown move policy %s.\n", config->policyName);
+		return 1;
+	}
+	memset(&script, 0, sizeof(script));
+	if (strcmp(policy->name, "replay") == 0 &&
+	    (config->scriptFileName == NULL || loadScript(&script, config->scriptFileName) == -1)) {
+		fprintf(stderr, "The replay policy needs a readable --script file.\n");
+		return 1;
+	}
+	memset(&player, 0, sizeof(player));
+	player.script = &script;
+	if (config->traceLogName != NULL && openTraceLog(&traceLog, config->traceLogName) == -1) {
+		return 1;
+	}
+
+	startTime = getSeconds();
+	for (gameNumber = 0; gameNumber < config->numGames; gameNumber++) {
+		// build a fresh world, or load the shared one for the first game
+		markTime = getSeconds();
+		if (config->worldFileName == NULL || gameNumber == 0) {
+			initGame(currentGame, &config->options, mixRandomSeed(config->seed, gameNumber));
+			if (config->worldFileName != NULL) {
+				loadGame(currentGame, config->worldFileName);
+			} else {
+				buildGame(currentGame);
+			}
+		}
+		buildSeconds += getSeconds() - markTime;
+
+		// give the player a stream that never overlaps the world's
+		seedRandom(&player.random, mixRandomSeed(config->seed, gameNumber));
+		jumpRandom(&player.random);
+
+		// play the game and report its steps
+		markTime = getSeconds();
+		if (config->traceLogName != NULL) {
+			beginTraceRecord(&traceLog, &currentGame->world, currentGame->seed, currentGame->minConn,
+			                 currentGame->builder.maxConn);
+		}
+		steps = playHeadless(&currentGame->world, policy, &player, config->maxMoves, &numCommands,
+		                     config->traceLogName != NULL ? &traceLog : NULL);
+		if (config->traceLogName != NULL) {
+			endTraceRecord(&traceLog);
+		}
+		playSeconds += getSeconds() - markTime;
+		totalCommands += numCommands;
+		if (steps >= 0) {
+			numFinished++;
+			totalSteps += steps;
+			// score the route against the shortest one
+			shortest = findPathDistance(getGameOracle(currentGame), currentGame->world.startRoomIndex,
+			                            currentGame->world.endRoomIndex);
+			totalShortest += shortest;
+			printf("game %d: %ld steps, shortest %d\n", gameNumber + 1, steps, shortest);
+		} else {
+			printf("game %d: abandoned after %ld moves\n", gameNumber + 1, numCommands);
+		}
+
+		if (config->worldFileName == NULL || gameNumber == config->numGames - 1) {
+			freeGame(currentGame);
+		}
+	}
+
+	// report totals and throughput
+	markTime = getSeconds() - startTime;
+	printf("policy %s: %d games, %d finished, %ld steps, %ld moves\n",
+	       policy->name, config->numGames, numFinished, totalSteps, totalCommands);
+	printf("shortest routes total %ld steps, score %.1f out of 100\n", totalShortest,
+	       totalSteps > 0 ? 100.0 * totalShortest / totalSteps : 0.0);
+	printf("build %.3f s, play %.3f s, total %.3f s\n", buildSeconds, playSeconds, markTime);
+	printf("%.1f games/sec, %.1f moves/sec\n",
+	       markTime > 0 ? config->numGames / markTime : 0.0,
+	       playSeconds > 0 ? totalCommands / playSeconds : 0.0);
+	if (config->traceLogName != NULL) {
+		closeTraceLog(&traceLog);
+		printf("trace log: %ld games, %llu bytes in %ld writes\n", traceLog.numRecords,
+		       (unsigned long long)traceLog.numBytes, traceLog.numWrites);
+	}
+
+	freeScript(&script);
+	free(currentGame);
+	return 0;
+}
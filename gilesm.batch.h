@@ -0,0 +1,79 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.batch.h
+ * Description: Headless batch mode. Plays many complete games in one process
+ *   with an automated player instead of a person at the keyboard. Nothing is
+ *   printed per turn and no game directory is created; each game reports its
+ *   step count and the batch reports overall games and moves per second.
+ *
+ *   Players choose their moves through a move policy, so new strategies can
+ *   be added without touching the game loop:
+ *     random  - walk to a random connected room
+ *     greedy  - walk to the connected room visited least so far
+ *     bfs     - move one room closer to the end by the path oracle
+ *     replay  - type the room names of a script file, one per line
+ *
+ *   With a trace log every game is appended to it as it ends, so the moves
+ *   can be replayed and profiled later with gilesm.tracelog.h.
+ *****************************************************************************/
+#ifndef GILESM_BATCH_H
+#define GILESM_BATCH_H
+
+#include <stdint.h>
+#include "gilesm.adventure.h"
+#include "gilesm.world.h"
+#include "gilesm.random.h"
+
+#define MOVE_QUIT -1					// the player has nothing left to type
+#define MOVE_UNKNOWN -2					// the player typed an unknown room
+
+struct BatchConfig {
+	int numGames;						// number of games to play
+	struct GameOptions options;			// settings for each generated world
+	uint64_t seed;						// base seed, game k uses stream k
+	const char *worldFileName;			// world for every game, NULL generates
+	const char *policyName;				// name of the move policy to use
+	const char *scriptFileName;			// room names for the replay policy
+	long maxMoves;						// commands before a game is abandoned
+	const char *traceLogName;			// shared log to record games in, or NULL
+};
+
+struct Script {
+	char *text;							// whole script file, lines terminated
+	int numLines;						// number of room names in the script
+	char **lines;						// start of each room name
+	int *lineLengths;					// characters in each room name
+};
+
+struct Player {
+	const struct World *world;			// world being played
+	struct Random random;				// random stream for the policy
+	const struct Script *script;		// script for the replay policy
+	int scriptPosition;					// next script line to type
+	int *visitCount;					// visits per room for greedy, or NULL
+	struct PathOracle oracle;			// distances to the end room for bfs
+};
+
+struct MovePolicy {
+	const char *name;					// name given to --policy
+	// prepare the player for a new game in its world
+	void (*startGame)(struct Player *player);
+	// room to move to, MOVE_UNKNOWN for an unknown name, or MOVE_QUIT
+	int (*nextMove)(struct Player *player, int currentRoom);
+	// release anything startGame allocated
+	void (*endGame)(struct Player *player);
+};
+
+// move policy with the specified name, or NULL if there is none
+const struct MovePolicy *findMovePolicy(const char *name);
+// read a script file of room names, returns 0 on success or -1
+int loadScript(struct Script *script, const char *fileName);
+// release all memory held by a script
+void freeScript(struct Script *script);
+// play one game with a policy, returns the number of steps or -1 if abandoned
+long playHeadless(const struct World *world, const struct MovePolicy *policy,
+                  struct Player *player, long maxMoves, long *numCommands, struct TraceLog *traceLog);
+// play and report every game of a batch, returns the process exit status
+int runBatch(const struct BatchConfig *config);
+
+#endif
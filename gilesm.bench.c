@@ -0,0 +1,547 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.bench.c
+ * Description: Benchmark of the game's hot paths. For each world size it
+ *   times initGame, buildGame, the binary world file (writeWorldFile and
+ *   loadWorldFile), the text room files (writeRoomFile, exportRoomFiles,
+ *   and readRoomFile), and playGame following a scripted shortest path.
+ *   Every result reports nanoseconds, allocations, and system calls per
+ *   operation, where an operation is one call of the function named, or
+ *   one room for exportRoomFiles.
+ *
+ *   Allocations are counted by wrapping malloc, calloc, and realloc at link
+ *   time (see BENCH_WRAP in the Makefile), so only the game's own requests
+ *   are seen. System calls are the kernel's count of read and write calls
+ *   from /proc/self/io plus the wrapped file system calls the game makes
+ *   directly (open, close, mmap, and the like, and raw calls such as
+ *   io_uring's).
+ *
+ *   Results are printed as a table, as CSV, or as JSON lines for tracking
+ *   over time:
+ *     gilesm.bench [--sizes 7,100,...] [--min-time SEC] [--text-max N]
+ *                  [--seed S] [--format text|csv|json]
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "gilesm.adventure.h"
+#include "gilesm.worldfile.h"
+#include "gilesm.batch.h"
+
+enum BenchFormat {
+	FORMAT_TEXT,
+	FORMAT_CSV,
+	FORMAT_JSON
+};
+
+struct BenchSample {
+	struct timespec time;				// monotonic clock
+	uint64_t numAllocs;					// allocations so far
+	uint64_t numSyscalls;				// system calls so far
+};
+
+struct BenchResult {
+	long numOps;						// operations timed
+	double nanoseconds;					// time spent in them
+	uint64_t numAllocs;					// allocations made by them
+	uint64_t numSyscalls;				// system calls made by them
+};
+
+struct BenchState {
+	struct GameOptions options;			// options of every world built
+	uint64_t seed;						// seed of the shared world
+	struct Game *game;					// game built fresh for each operation
+	struct Game *shared;				// world every file and play bench uses
+	struct World loaded;				// world mapped by loadWorldFile
+	char scriptFileName[600];			// shortest path, one room per line
+	long rep;							// repetition being run
+};
+
+struct BenchCase {
+	const char *name;					// function being measured
+	int textFiles;						// uses one text file per room
+	// prepare one repetition, untimed
+	void (*setup)(struct BenchState *state);
+	// run one repetition, timed, and return the number of operations
+	long (*run)(struct BenchState *state);
+	// undo what setup and run created, untimed
+	void (*teardown)(struct BenchState *state);
+};
+
+/*
+ * Counters behind the link time wrappers.
+ */
+static uint64_t numAllocs;
+static uint64_t numFileCalls;
+static int ioStatsFile = -1;
+static uint64_t ioStatsOverhead;
+static int playOutput = -1;
+static int savedOutput = -1;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *address, size_t size);
+int __real_open(const char *path, int flags, ...);
+int __real_close(int file_descriptor);
+void *__real_mmap(void *address, size_t length, int protection, int flags, int file_descriptor, off_t offset);
+int __real_munmap(void *address, size_t length);
+int __real_fstat(int file_descriptor, struct stat *status);
+int __real_mkdir(const char *path, mode_t mode);
+int __real_rename(const char *oldPath, const char *newPath);
+int __real_unlink(const char *path);
+FILE *__real_fopen(const char *path, const char *mode);
+long __real_syscall(long number, ...);
+int __real_fclose(FILE *fp);
+
+void *__wrap_malloc(size_t size) {
+	numAllocs++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+	numAllocs++;
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *address, size_t size) {
+	numAllocs++;
+	return __real_realloc(address, size);
+}
+
+int __wrap_open(const char *path, int flags, ...) {
+	mode_t mode = 0;
+	va_list args;
+
+	if (flags & O_CREAT) {
+		va_start(args, flags);
+		mode = va_arg(args, mode_t);
+		va_end(args);
+	}
+	numFileCalls++;
+	return __real_open(path, flags, mode);
+}
+
+int __wrap_close(int file_descriptor) {
+	numFileCalls++;
+	return __real_close(file_descriptor);
+}
+
+void *__wrap_mmap(void *address, size_t length, int protection, int flags, int file_descriptor, off_t offset) {
+	numFileCalls++;
+	return __real_mmap(address, length, protection, flags, file_descriptor, offset);
+}
+
+int __wrap_munmap(void *address, size_t length) {
+	numFileCalls++;
+	return __real_munmap(address, length);
+}
+
+int __wrap_fstat(int file_descriptor, struct stat *status) {
+	numFileCalls++;
+	return __real_fstat(file_descriptor, status);
+}
+
+int __wrap_mkdir(const char *path, mode_t mode) {
+	numFileCalls++;
+	return __real_mkdir(path, mode);
+}
+
+int __wrap_rename(const char *oldPath, const char *newPath) {
+	numFileCalls++;
+	return __real_rename(oldPath, newPath);
+}
+
+int __wrap_unlink(const char *path) {
+	numFileCalls++;
+	return __real_unlink(path);
+}
+
+// fopen and fclose stand for the open and close calls made inside the library
+FILE *__wrap_fopen(const char *path, const char *mode) {
+	numFileCalls++;
+	return __real_fopen(path, mode);
+}
+
+int __wrap_fclose(FILE *fp) {
+	numFileCalls++;
+	return __real_fclose(fp);
+}
+
+// raw system calls, such as io_uring's, always take at most six arguments
+long __wrap_syscall(long number, ...) {
+	long arguments[6];
+	va_list args;
+	int i = 0;
+
+	va_start(args, number);
+	for (i = 0; i < 6; i++) {
+		arguments[i] = va_arg(args, long);
+	}
+	va_end(args);
+	numFileCalls++;
+	return __real_syscall(number, arguments[0], arguments[1], arguments[2],
+	                      arguments[3], arguments[4], arguments[5]);
+}
+
+// read and write calls counted by the kernel, or 0 without /proc/self/io
+static uint64_t readIoCalls(void) {
+	char buffer[512],
+		 *field;
+	ssize_t length;
+	uint64_t total = 0;
+
+	if (ioStatsFile == -1) {
+		return 0;
+	}
+	length = pread(ioStatsFile, buffer, sizeof(buffer) - 1, 0);
+	if (length <= 0) {
+		return 0;
+	}
+	buffer[length] = '\0';
+	if ((field = strstr(buffer, "syscr: ")) != NULL) {
+		total += strtoull(field + 7, NULL, 10);
+	}
+	if ((field = strstr(buffer, "syscw: ")) != NULL) {
+		total += strtoull(field + 7, NULL, 10);
+	}
+	return total;
+}
+
+// take a sample of the clock and every counter
+static void takeSample(struct BenchSample *sample) {
+	sample->numSyscalls = readIoCalls() + numFileCalls;
+	sample->numAllocs = numAllocs;
+	clock_gettime(CLOCK_MONOTONIC, &sample->time);
+}
+
+// add the difference between two samples to a result
+static void addSamples(struct BenchResult *result, const struct BenchSample *start,
+                       const struct BenchSample *end) {
+	uint64_t numSyscalls = end->numSyscalls - start->numSyscalls;
+
+	result->nanoseconds += (end->time.tv_sec - start->time.tv_sec) * 1e9 +
+	                       (end->time.tv_nsec - start->time.tv_nsec);
+	result->numAllocs += end->numAllocs - start->numAllocs;
+	result->numSyscalls += numSyscalls > ioStatsOverhead ? numSyscalls - ioStatsOverhead : 0;
+}
+
+/*
+ * Benchmark cases.
+ */
+static void newGameSetup(struct BenchState *state) {
+	initGame(state->game, &state->options, mixRandomSeed(state->seed, state->rep));
+}
+
+static void freeGameTeardown(struct BenchState *state) {
+	freeGame(state->game);
+}
+
+static long initGameRun(struct BenchState *state) {
+	initGame(state->game, &state->options, mixRandomSeed(state->seed, state->rep));
+	return 1;
+}
+
+static long buildGameRun(struct BenchState *state) {
+	buildGame(state->game);
+	return 1;
+}
+
+static long writeWorldFileRun(struct BenchState *state) {
+	writeWorldFile(&state->shared->world, state->shared->worldFileName);
+	return 1;
+}
+
+static long loadWorldFileRun(struct BenchState *state) {
+	if (loadWorldFile(&state->loaded, state->shared->worldFileName) == -1) {
+		exit(1);
+	}
+	return 1;
+}
+
+static void loadWorldFileTeardown(struct BenchState *state) {
+	freeWorld(&state->loaded);
+}
+
+static long writeRoomFileRun(struct BenchState *state) {
+	int i = 0;
+
+	for (i = 0; i < state->shared->world.numRooms; i++) {
+		writeRoomFile(state->shared, i);
+	}
+	return state->shared->world.numRooms;
+}
+
+static long exportRoomFilesRun(struct BenchState *state) {
+	exportRoomFiles(state->shared);
+	return state->shared->world.numRooms;
+}
+
+static void readRoomFileSetup(struct BenchState *state) {
+	clearWorldBuilder(&state->shared->builder);
+}
+
+static long readRoomFileRun(struct BenchState *state) {
+	int i = 0;
+
+	for (i = 0; i < state->shared->world.numRooms; i++) {
+		readRoomFile(state->shared, i);
+	}
+	return state->shared->world.numRooms;
+}
+
+// check every connection came back from the room files
+static void readRoomFileTeardown(struct BenchState *state) {
+	long numConns = 0;
+	int i = 0;
+
+	for (i = 0; i < state->shared->builder.numRooms; i++) {
+		numConns += state->shared->builder.numConn[i];
+	}
+	if (numConns != state->shared->world.numConns) {
+		fprintf(stderr, "readRoomFile read %ld of %d connections.\n", numConns, state->shared->world.numConns);
+		exit(1);
+	}
+}
+
+// feed the script to playGame and send its screen output nowhere
+static void playGameSetup(struct BenchState *state) {
+	state->shared->stepCount = 0;
+	rewind(stdin);
+	fflush(stdout);
+	dup2(playOutput, STDOUT_FILENO);
+}
+
+static long playGameRun(struct BenchState *state) {
+	playGame(state->shared);
+	fflush(stdout);
+	return 1;
+}
+
+static void playGameTeardown(struct BenchState *state) {
+	dup2(savedOutput, STDOUT_FILENO);
+}
+
+static const struct BenchCase benchCases[] = {
+	{ "initGame", 0, NULL, initGameRun, freeGameTeardown },
+	{ "buildGame", 0, newGameSetup, buildGameRun, freeGameTeardown },
+	{ "writeWorldFile", 0, NULL, writeWorldFileRun, NULL },
+	{ "loadWorldFile", 0, NULL, loadWorldFileRun, loadWorldFileTeardown },
+	{ "writeRoomFile", 1, NULL, writeRoomFileRun, NULL },
+	{ "exportRoomFiles", 1, NULL, exportRoomFilesRun, NULL },
+	{ "readRoomFile", 1, readRoomFileSetup, readRoomFileRun, readRoomFileTeardown },
+	{ "playGame", 0, playGameSetup, playGameRun, playGameTeardown }
+};
+
+/******************************************************************************
+ * Function Name: runBenchCase
+ * Description: Repeat a case until it has run for at least minTime seconds,
+ *   timing and counting only its run step.
+ *****************************************************************************/
+static void runBenchCase(const struct BenchCase *benchCase, struct BenchState *state,
+                         double minTime, struct BenchResult *result) {
+	struct BenchSample start,
+					   end;
+
+	memset(result, 0, sizeof(*result));
+	for (state->rep = 0; state->rep == 0 || result->nanoseconds < minTime * 1e9; state->rep++) {
+		if (benchCase->setup != NULL) {
+			benchCase->setup(state);
+		}
+		takeSample(&start);
+		result->numOps += benchCase->run(state);
+		takeSample(&end);
+		if (benchCase->teardown != NULL) {
+			benchCase->teardown(state);
+		}
+		addSamples(result, &start, &end);
+	}
+}
+
+/******************************************************************************
+ * Function Name: printResult
+ * Description: Print one result per operation in the requested format.
+ *****************************************************************************/
+static void printResult(enum BenchFormat format, const char *name, int numRooms,
+                        uint64_t seed, const struct BenchResult *result) {
+	double nanoseconds = result->nanoseconds / result->numOps,
+		   allocs = (double)result->numAllocs / result->numOps,
+		   syscalls = ioStatsFile == -1 ? -1.0 : (double)result->numSyscalls / result->numOps;
+
+	if (format == FORMAT_JSON) {
+		printf("{\"benchmark\":\"%s\",\"rooms\":%d,\"seed\":%llu,\"ops\":%ld,"
+		       "\"ns_per_op\":%.1f,\"allocs_per_op\":%.3f,\"syscalls_per_op\":%.3f}\n",
+		       name, numRooms, (unsigned long long)seed, result->numOps, nanoseconds, allocs, syscalls);
+	} else if (format == FORMAT_CSV) {
+		printf("%s,%d,%llu,%ld,%.1f,%.3f,%.3f\n", name, numRooms, (unsigned long long)seed,
+		       result->numOps, nanoseconds, allocs, syscalls);
+	} else {
+		printf("%-15s %8d %10ld %14.1f %12.2f %12.2f\n", name, numRooms, result->numOps,
+		       nanoseconds, allocs, syscalls);
+	}
+	fflush(stdout);
+}
+
+/******************************************************************************
+ * Function Name: writeScript
+ * Description: Write the room names of a shortest path from the start room
+ *   to the end room, one per line, for playGame to read.
+ *****************************************************************************/
+static void writeScript(const struct World *world, const char *fileName) {
+	const struct MovePolicy *policy = findMovePolicy("bfs");
+	struct Player player;
+	FILE *fp = fopen(fileName, "w");
+	int room = world->startRoomIndex;
+
+	if (fp == NULL) {
+		fprintf(stderr, "Could not open %s to write the script.\n", fileName);
+		exit(1);
+	}
+	memset(&player, 0, sizeof(player));
+	player.world = world;
+	policy->startGame(&player);
+	while ((room = policy->nextMove(&player, room)) != MOVE_QUIT) {
+		fprintf(fp, "%s\n", getRoomName(world, room));
+	}
+	policy->endGame(&player);
+	fclose(fp);
+}
+
+/******************************************************************************
+ * Function Name: removeGameDir
+ * Description: Delete the files a benchmark left in the game directory, then
+ *   the directory itself.
+ *****************************************************************************/
+static void removeGameDir(struct Game *currentGame, int numRoomFiles) {
+	char fileName[600];
+	int i = 0;
+
+	for (i = 0; i < numRoomFiles; i++) {
+		snprintf(fileName, sizeof(fileName), "%s/file%d", currentGame->dirPath, i);
+		unlink(fileName);
+	}
+	unlink(currentGame->worldFileName);
+	snprintf(fileName, sizeof(fileName), "%s/script", currentGame->dirPath);
+	unlink(fileName);
+	rmdir(currentGame->dirPath);
+}
+
+/******************************************************************************
+ * Function Name: benchWorldSize
+ * Description: Run every case on worlds of the specified size. The file and
+ *   play cases share one world built from the base seed; text room files are
+ *   skipped for worlds larger than textMax rooms.
+ *****************************************************************************/
+static void benchWorldSize(struct BenchState *state, int numRooms, int textMax,
+                           double minTime, enum BenchFormat format) {
+	struct BenchResult result;
+	int numCases = sizeof(benchCases) / sizeof(benchCases[0]),
+		useText = numRooms <= textMax,
+		i = 0;
+
+	state->options.numRooms = numRooms;
+	initGame(state->shared, &state->options, state->seed);
+	initGameDir(state->shared);
+	buildGame(state->shared);
+	snprintf(state->scriptFileName, sizeof(state->scriptFileName), "%s/script", state->shared->dirPath);
+	writeScript(&state->shared->world, state->scriptFileName);
+	if (freopen(state->scriptFileName, "r", stdin) == NULL) {
+		fprintf(stderr, "Could not open %s to read the script.\n", state->scriptFileName);
+		exit(1);
+	}
+	if (useText) {
+		for (i = 0; i < numRooms; i++) {
+			createRoomFile(state->shared, i);
+		}
+	}
+
+	for (i = 0; i < numCases; i++) {
+		if (benchCases[i].textFiles && !useText) {
+			continue;
+		}
+		runBenchCase(&benchCases[i], state, minTime, &result);
+		printResult(format, benchCases[i].name, numRooms, state->seed, &result);
+	}
+
+	removeGameDir(state->shared, useText ? numRooms : 0);
+	freeGame(state->shared);
+}
+
+int main(int argc, char *argv[]) {
+	struct BenchState state;
+	enum BenchFormat format = FORMAT_TEXT;
+	const char *sizes = "7,100,1000,10000,100000,1000000";
+	char *end;
+	double minTime = 0.2;
+	int textMax = 10000,
+		numRooms,
+		i = 0;
+
+	memset(&state, 0, sizeof(state));
+	initGameOptions(&state.options);
+	state.seed = 1;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+			sizes = argv[++i];
+		} else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+			minTime = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--text-max") == 0 && i + 1 < argc) {
+			textMax = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			state.seed = strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && strcmp(argv[i + 1], "text") == 0) {
+			format = FORMAT_TEXT;
+			i++;
+		} else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && strcmp(argv[i + 1], "csv") == 0) {
+			format = FORMAT_CSV;
+			i++;
+		} else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && strcmp(argv[i + 1], "json") == 0) {
+			format = FORMAT_JSON;
+			i++;
+		} else {
+			fprintf(stderr, "usage: %s [--sizes 7,100,...] [--min-time SEC] [--text-max N]\n"
+			                "       [--seed S] [--format text|csv|json]\n", argv[0]);
+			exit(1);
+		}
+	}
+
+	// count the read calls made just to take a sample, so they can be ignored
+	ioStatsFile = __real_open("/proc/self/io", O_RDONLY);
+	if (ioStatsFile != -1) {
+		uint64_t first = readIoCalls();
+		ioStatsOverhead = readIoCalls() - first;
+	}
+	// keep the real screen for results while playGame writes to /dev/null
+	playOutput = __real_open("/dev/null", O_WRONLY);
+	savedOutput = dup(STDOUT_FILENO);
+	state.game = malloc(sizeof(struct Game));
+	state.shared = malloc(sizeof(struct Game));
+	if (playOutput == -1 || savedOutput == -1 || state.game == NULL || state.shared == NULL) {
+		fprintf(stderr, "Could not prepare the benchmark.\n");
+		exit(1);
+	}
+
+	if (format == FORMAT_CSV) {
+		printf("benchmark,rooms,seed,ops,ns_per_op,allocs_per_op,syscalls_per_op\n");
+	} else if (format == FORMAT_TEXT) {
+		printf("%-15s %8s %10s %14s %12s %12s\n", "benchmark", "rooms", "ops",
+		       "ns/op", "allocs/op", "syscalls/op");
+	}
+	for (numRooms = strtol(sizes, &end, 10); end != sizes; numRooms = strtol(sizes, &end, 10)) {
+		if (numRooms >= 2) {
+			benchWorldSize(&state, numRooms, textMax, minTime, format);
+		}
+		sizes = (*end == ',') ? end + 1 : end;
+	}
+
+	free(state.game);
+	free(state.shared);
+	return 0;
+}
@@ -0,0 +1,44 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.config.h
+ * Description: Shape of the classic game and the build settings that depend
+ *   on it, kept in one place. The classic options (initGameOptions), the
+ *   built-in name list (gilesm.names.c), and the fixed engine
+ *   (gilesm.fixed.h) all take their sizes from here.
+ *
+ *   The fixed engine is compiled for exactly the classic shape, with every
+ *   array sized and every loop bounded by these constants. Any of them can
+ *   be overridden when building, e.g. make CPPFLAGS=-DCLASSIC_ROOMS=12, to
+ *   specialize it for another small world; the runtime-sized engine builds
+ *   every other world. Building with make ENGINE=runtime leaves the fixed
+ *   engine out altogether.
+ *****************************************************************************/
+#ifndef GILESM_CONFIG_H
+#define GILESM_CONFIG_H
+
+#ifndef CLASSIC_ROOMS
+#define CLASSIC_ROOMS 7						// rooms in a classic world
+#endif
+#ifndef CLASSIC_MIN_CONN
+#define CLASSIC_MIN_CONN 3					// fewest connections a classic room may have
+#endif
+#ifndef CLASSIC_MAX_CONN
+#define CLASSIC_MAX_CONN 6					// most connections a classic room may have
+#endif
+#define CLASSIC_NUM_NAMES 10				// names in the built-in name list
+
+#define MAX_NAME_LENGTH 48					// longest name a dictionary may hold
+#define ROOM_NAME_SIZE 64					// buffer for any picked or composite name
+
+#ifndef FIXED_ENGINE
+#define FIXED_ENGINE 1						// 0 builds without the fixed engine
+#endif
+
+// every room of a fixed world is one bit of a 64 bit word
+_Static_assert(CLASSIC_ROOMS >= 2 && CLASSIC_ROOMS <= 64, "CLASSIC_ROOMS must be 2 to 64");
+// initGame caps the connection bounds, so the fixed shape must already fit
+_Static_assert(CLASSIC_MIN_CONN >= 1 && CLASSIC_MIN_CONN <= CLASSIC_MAX_CONN &&
+               CLASSIC_MAX_CONN <= CLASSIC_ROOMS - 1, "classic connection bounds do not fit the rooms");
+_Static_assert(CLASSIC_MAX_CONN >= 2 || CLASSIC_ROOMS == 2, "classic rooms cannot all be joined");
+
+#endif
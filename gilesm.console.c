@@ -0,0 +1,174 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.console.c
+ * Description: Buffered terminal described in gilesm.console.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "gilesm.console.h"
+#include "gilesm.stats.h"
+
+// grow a buffer until it holds at least the specified number of bytes
+static char *growBuffer(char *buffer, size_t *capacity, size_t needed) {
+	if (needed > *capacity) {
+		while (*capacity < needed) {
+			*capacity *= 2;
+		}
+		buffer = realloc(buffer, *capacity);
+		if (buffer == NULL) {
+			fprintf(stderr, "Could not allocate %zu bytes of console buffer.\n", *capacity);
+			exit(1);
+		}
+	}
+	return buffer;
+}
+
+/******************************************************************************
+ * Function Name: initConsole
+ * Description: Set up a console with empty input and output buffers of
+ *   CONSOLE_BUFFER_SIZE bytes on the specified descriptors.
+ *****************************************************************************/
+void initConsole(struct Console *console, int inputDescriptor, int outputDescriptor) {
+	console->inputDescriptor = inputDescriptor;
+	console->outputDescriptor = outputDescriptor;
+	console->inputStart = 0;
+	console->inputLength = 0;
+	console->inputCapacity = CONSOLE_BUFFER_SIZE;
+	console->inputEnded = 0;
+	console->outputLength = 0;
+	console->outputCapacity = CONSOLE_BUFFER_SIZE;
+	console->input = malloc(console->inputCapacity);
+	console->output = malloc(console->outputCapacity);
+	if (console->input == NULL || console->output == NULL) {
+		fprintf(stderr, "Could not allocate console buffers.\n");
+		exit(1);
+	}
+}
+
+/******************************************************************************
+ * Function Name: freeConsole
+ * Description: Write any output still gathered and release both buffers.
+ *   Input read but not handed out is dropped.
+ *****************************************************************************/
+void freeConsole(struct Console *console) {
+	flushConsole(console);
+	free(console->input);
+	free(console->output);
+	console->input = NULL;
+	console->output = NULL;
+}
+
+/******************************************************************************
+ * Function Name: readConsoleLine
+ * Description: Returns the next line of input with its newline, and any
+ *   carriage return before it, replaced by a terminating null character,
+ *   and stores its length. A last line with no newline is returned as it
+ *   is. Lines already read are handed out without a system call; only when
+ *   none is complete is the gathered output written and more input read,
+ *   as much as has arrived, up to the free space in the buffer. Returns
+ *   NULL once the input has ended and every line has been handed out.
+ *****************************************************************************/
+char *readConsoleLine(struct Console *console, size_t *length) {
+	char *line,
+		 *newline;
+	ssize_t nread;
+
+	while (1) {
+		line = console->input + console->inputStart;
+		newline = memchr(line, '\n', console->inputLength - console->inputStart);
+		if (newline != NULL || (console->inputEnded && console->inputStart < console->inputLength)) {
+			*length = (newline != NULL ? newline : console->input + console->inputLength) - line;
+			console->inputStart += *length + (newline != NULL);
+			if (*length > 0 && line[*length - 1] == '\r') {
+				(*length)--;
+			}
+			line[*length] = '\0';
+			// a long run of queued turns still reaches the screen in pieces
+			if (console->outputLength >= CONSOLE_BUFFER_SIZE) {
+				flushConsole(console);
+			}
+			return line;
+		}
+		if (console->inputEnded) {
+			return NULL;
+		}
+
+		// keep the partial line at the front, with room for more and a terminator
+		memmove(console->input, line, console->inputLength - console->inputStart);
+		console->inputLength -= console->inputStart;
+		console->inputStart = 0;
+		console->input = growBuffer(console->input, &console->inputCapacity,
+		                            console->inputLength + CONSOLE_BUFFER_SIZE / 2);
+		// the player sees everything before being waited on
+		flushConsole(console);
+		nread = read(console->inputDescriptor, console->input + console->inputLength,
+		             console->inputCapacity - console->inputLength - 1);
+		countStatIo(STAT_IO_TERMINAL, 1, nread > 0 ? nread : 0);
+		if (nread < 0 && errno == EINTR) {
+			continue;
+		}
+		if (nread <= 0) {
+			console->inputEnded = 1;
+		} else {
+			console->inputLength += nread;
+		}
+	}
+}
+
+/******************************************************************************
+ * Function Name: reserveConsole
+ * Description: Returns space for at least the specified number of bytes at
+ *   the end of the gathered output. Nothing is kept until commitConsole.
+ *****************************************************************************/
+char *reserveConsole(struct Console *console, size_t size) {
+	console->output = growBuffer(console->output, &console->outputCapacity, console->outputLength + size);
+	return console->output + console->outputLength;
+}
+
+/******************************************************************************
+ * Function Name: commitConsole
+ * Description: Keep the specified number of bytes written into the space
+ *   reserveConsole returned.
+ *****************************************************************************/
+void commitConsole(struct Console *console, size_t length) {
+	console->outputLength += length;
+}
+
+/******************************************************************************
+ * Function Name: writeConsole
+ * Description: Add bytes to the gathered output.
+ *****************************************************************************/
+void writeConsole(struct Console *console, const char *text, size_t length) {
+	memcpy(reserveConsole(console, length), text, length);
+	commitConsole(console, length);
+}
+
+/******************************************************************************
+ * Function Name: flushConsole
+ * Description: Write all gathered output, resuming after short writes, and
+ *   empty the buffer. Returns 0 on success or -1 if the output could not be
+ *   written, in which case it is dropped.
+ *****************************************************************************/
+int flushConsole(struct Console *console) {
+	size_t written = 0;
+	ssize_t nwritten;
+
+	while (written < console->outputLength) {
+		nwritten = write(console->outputDescriptor, console->output + written,
+		                 console->outputLength - written);
+		countStatIo(STAT_IO_TERMINAL, 1, nwritten > 0 ? nwritten : 0);
+		if (nwritten < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			console->outputLength = 0;
+			return -1;
+		}
+		written += nwritten;
+	}
+	console->outputLength = 0;
+	return 0;
+}
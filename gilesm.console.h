@@ -0,0 +1,51 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.console.h
+ * Description: Buffered terminal for the game loops. Input is read from a
+ *   descriptor in chunks of up to CONSOLE_BUFFER_SIZE bytes and handed out a
+ *   line at a time, so a bot or a pipe that sends many commands at once has
+ *   them all taken in by one read and played without waiting on another.
+ *   Lines have no length limit; the buffer grows to hold the longest one.
+ *
+ *   Output is gathered in memory and written with one write only when the
+ *   game must wait for input that has not arrived yet, or when a large
+ *   batch of turns has piled up. A person at the keyboard sees every prompt
+ *   before typing, exactly as before, while piped input costs one read and
+ *   one write per chunk instead of several calls per turn.
+ *****************************************************************************/
+#ifndef GILESM_CONSOLE_H
+#define GILESM_CONSOLE_H
+
+#include <stddef.h>
+
+#define CONSOLE_BUFFER_SIZE 65536			// bytes read at once, and written once gathered
+
+struct Console {
+	int inputDescriptor;				// descriptor commands are read from
+	int outputDescriptor;				// descriptor the screen is written to
+	char *input;						// bytes read but not yet handed out
+	size_t inputStart;					// first byte of the next line
+	size_t inputLength;					// bytes used in input
+	size_t inputCapacity;				// bytes allocated for input
+	int inputEnded;						// the input descriptor reached its end
+	char *output;						// screen output not yet written
+	size_t outputLength;				// bytes used in output
+	size_t outputCapacity;				// bytes allocated for output
+};
+
+// set up a console on an input and an output descriptor
+void initConsole(struct Console *console, int inputDescriptor, int outputDescriptor);
+// write any gathered output and release the console's buffers
+void freeConsole(struct Console *console);
+// next line without its line ending, terminated in place, or NULL once input ends
+char *readConsoleLine(struct Console *console, size_t *length);
+// space for at least size more bytes of output, kept by commitConsole
+char *reserveConsole(struct Console *console, size_t size);
+// keep the specified number of bytes written into the reserved space
+void commitConsole(struct Console *console, size_t length);
+// gather bytes of output
+void writeConsole(struct Console *console, const char *text, size_t length);
+// write all gathered output, returns 0 on success or -1
+int flushConsole(struct Console *console);
+
+#endif
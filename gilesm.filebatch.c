@@ -0,0 +1,370 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.filebatch.c
+ * Description: Batched file writing described in gilesm.filebatch.h. The
+ *   io_uring instance is driven with raw system calls, so no library beyond
+ *   the kernel headers is needed.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "gilesm.filebatch.h"
+
+// completions for a file's close carry this bit in their user data
+#define CLOSE_USER_DATA 0x10000
+
+/******************************************************************************
+ * Function Name: openFileRing
+ * Description: Set up an io_uring instance with room for a batch of writes
+ *   and their closes, and map its rings. Returns 0 on success, or -1 with
+ *   the ring left unused if the kernel refuses any step.
+ *****************************************************************************/
+static int openFileRing(struct FileBatch *batch) {
+	struct FileRing *ring = &batch->ring;
+	struct io_uring_params params;
+	char *sqRing,
+		 *cqRing;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&params, 0, sizeof(params));
+	ring->ringFd = syscall(__NR_io_uring_setup, FILE_BATCH_SIZE * 2, &params);
+	batch->numCalls++;
+	if (ring->ringFd < 0) {
+		ring->ringFd = -1;
+		return -1;
+	}
+
+	// map the submission ring, the completion ring, and the entries
+	ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cqRingSize > ring->sqRingSize) {
+			ring->sqRingSize = ring->cqRingSize;
+		}
+		ring->cqRingSize = 0;
+	}
+	ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                    ring->ringFd, IORING_OFF_SQ_RING);
+	ring->cqRing = ring->cqRingSize == 0 ? ring->sqRing :
+	               mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                    ring->ringFd, IORING_OFF_CQ_RING);
+	ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+	                  ring->ringFd, IORING_OFF_SQES);
+	batch->numCalls += ring->cqRingSize == 0 ? 2 : 3;
+	if (ring->sqRing == MAP_FAILED || ring->cqRing == MAP_FAILED || ring->sqes == MAP_FAILED) {
+		if (ring->sqRing != MAP_FAILED) {
+			munmap(ring->sqRing, ring->sqRingSize);
+		}
+		if (ring->cqRingSize != 0 && ring->cqRing != MAP_FAILED) {
+			munmap(ring->cqRing, ring->cqRingSize);
+		}
+		if (ring->sqes != MAP_FAILED) {
+			munmap(ring->sqes, ring->sqesSize);
+		}
+		close(ring->ringFd);
+		memset(ring, 0, sizeof(*ring));
+		ring->ringFd = -1;
+		return -1;
+	}
+
+	sqRing = ring->sqRing;
+	cqRing = ring->cqRing;
+	ring->sqTail = (unsigned int *)(sqRing + params.sq_off.tail);
+	ring->sqMask = (unsigned int *)(sqRing + params.sq_off.ring_mask);
+	ring->sqArray = (unsigned int *)(sqRing + params.sq_off.array);
+	ring->cqHead = (unsigned int *)(cqRing + params.cq_off.head);
+	ring->cqTail = (unsigned int *)(cqRing + params.cq_off.tail);
+	ring->cqMask = (unsigned int *)(cqRing + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cqRing + params.cq_off.cqes);
+	return 0;
+}
+
+// unmap the rings and close the instance
+static void closeFileRing(struct FileBatch *batch) {
+	struct FileRing *ring = &batch->ring;
+
+	if (ring->ringFd == -1) {
+		return;
+	}
+	munmap(ring->sqes, ring->sqesSize);
+	if (ring->cqRingSize != 0) {
+		munmap(ring->cqRing, ring->cqRingSize);
+	}
+	munmap(ring->sqRing, ring->sqRingSize);
+	close(ring->ringFd);
+	batch->numCalls += ring->cqRingSize == 0 ? 3 : 4;
+	memset(ring, 0, sizeof(*ring));
+	ring->ringFd = -1;
+}
+
+// claim the next submission entry, cleared; the caller fills it in
+static struct io_uring_sqe *getRingEntry(struct FileRing *ring, unsigned int *tail) {
+	unsigned int slot = *tail & *ring->sqMask;
+	struct io_uring_sqe *sqe = &ring->sqes[slot];
+
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sqArray[slot] = slot;
+	(*tail)++;
+	return sqe;
+}
+
+/******************************************************************************
+ * Function Name: runFileRing
+ * Description: Publish the entries claimed up to tail, submit them, and
+ *   wait for as many completions. Each completion's result is stored by its
+ *   user data: in opened for an open, written for a write, or closed for a
+ *   close. Returns 0 once all have completed, or -1 if the ring fails.
+ *****************************************************************************/
+static int runFileRing(struct FileBatch *batch, unsigned int tail, unsigned int numEntries,
+                       int *opened, int *written, int *closed) {
+	struct FileRing *ring = &batch->ring;
+	unsigned int head,
+				 numSubmitted = 0,
+				 numDone = 0;
+	long result;
+	struct io_uring_cqe *cqe;
+
+	__atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+	while (numDone < numEntries) {
+		// submit what is left and wait in the same call
+		result = syscall(__NR_io_uring_enter, ring->ringFd, numEntries - numSubmitted,
+		                 numEntries - numDone, IORING_ENTER_GETEVENTS, NULL, 0);
+		batch->numCalls++;
+		if (result < 0) {
+			if (errno != EINTR) {
+				return -1;
+			}
+		} else {
+			numSubmitted += result;
+		}
+		head = *ring->cqHead;
+		while (head != __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE)) {
+			cqe = &ring->cqes[head & *ring->cqMask];
+			if (cqe->user_data & CLOSE_USER_DATA) {
+				closed[cqe->user_data & ~CLOSE_USER_DATA] = cqe->res;
+			} else if (opened != NULL) {
+				opened[cqe->user_data] = cqe->res;
+			} else {
+				written[cqe->user_data] = cqe->res;
+			}
+			head++;
+			numDone++;
+		}
+		__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+	}
+	return 0;
+}
+
+// write all of a text at an offset, returns 0 on success or -1
+static int writeWholeText(struct FileBatch *batch, int file_descriptor, const char *text,
+                          size_t length, off_t offset) {
+	ssize_t nwritten;
+
+	while (length > 0) {
+		nwritten = pwrite(file_descriptor, text, length, offset);
+		batch->numCalls++;
+		if (nwritten < 0 && errno == EINTR) {
+			continue;
+		}
+		if (nwritten <= 0) {
+			return -1;
+		}
+		batch->numBytes += nwritten;
+		text += nwritten;
+		length -= nwritten;
+		offset += nwritten;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: writeBatchPlain
+ * Description: Write each queued file with one open, one write, and one
+ *   close, counting the files that fail.
+ *****************************************************************************/
+static void writeBatchPlain(struct FileBatch *batch) {
+	int file_descriptor,
+		i = 0;
+
+	for (i = 0; i < batch->numFiles; i++) {
+		file_descriptor = open(batch->fileNames[i], O_WRONLY | O_CREAT | O_TRUNC, FILE_BATCH_MODE);
+		batch->numCalls += 2;
+		if (file_descriptor == -1) {
+			fprintf(stderr, "Could not open %s to write to file.\n", batch->fileNames[i]);
+			batch->numFailed++;
+			continue;
+		}
+		if (writeWholeText(batch, file_descriptor, batch->texts[i], batch->lengths[i], 0) == -1 ||
+		    close(file_descriptor) == -1) {
+			fprintf(stderr, "Could not write %s.\n", batch->fileNames[i]);
+			batch->numFailed++;
+		}
+	}
+}
+
+/******************************************************************************
+ * Function Name: writeBatchRing
+ * Description: Write the queued files through the ring: every open is
+ *   submitted at once, then every write with its file's close linked behind
+ *   it. A short write cancels its close, so the rest is written and the file
+ *   closed here. Returns 0 once every file is accounted for, or -1 if the
+ *   ring itself failed, after closing whatever files it is known to hold.
+ *****************************************************************************/
+static int writeBatchRing(struct FileBatch *batch) {
+	struct FileRing *ring = &batch->ring;
+	struct io_uring_sqe *sqe;
+	unsigned int tail = *ring->sqTail,
+				 numEntries = 0;
+	int written[FILE_BATCH_SIZE],
+		closed[FILE_BATCH_SIZE],
+		i = 0;
+	size_t length;
+
+	// open every file with one submission
+	for (i = 0; i < batch->numFiles; i++) {
+		batch->fileDescriptors[i] = -1;
+		sqe = getRingEntry(ring, &tail);
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = (unsigned long)batch->fileNames[i];
+		sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+		sqe->len = FILE_BATCH_MODE;
+		sqe->user_data = i;
+	}
+	if (runFileRing(batch, tail, batch->numFiles, batch->fileDescriptors, NULL, NULL) == -1) {
+		for (i = 0; i < batch->numFiles; i++) {
+			if (batch->fileDescriptors[i] >= 0) {
+				close(batch->fileDescriptors[i]);
+			}
+		}
+		return -1;
+	}
+
+	// write and close every opened file with one more
+	for (i = 0; i < batch->numFiles; i++) {
+		written[i] = -ECANCELED;
+		closed[i] = -ECANCELED;
+		if (batch->fileDescriptors[i] < 0) {
+			continue;
+		}
+		length = batch->lengths[i] < (1u << 30) ? batch->lengths[i] : (1u << 30);
+		sqe = getRingEntry(ring, &tail);
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = batch->fileDescriptors[i];
+		sqe->addr = (unsigned long)batch->texts[i];
+		sqe->len = length;
+		sqe->off = 0;
+		sqe->flags = IOSQE_IO_LINK;
+		sqe->user_data = i;
+		sqe = getRingEntry(ring, &tail);
+		sqe->opcode = IORING_OP_CLOSE;
+		sqe->fd = batch->fileDescriptors[i];
+		sqe->user_data = i | CLOSE_USER_DATA;
+		numEntries += 2;
+	}
+	if (numEntries > 0 && runFileRing(batch, tail, numEntries, NULL, written, closed) == -1) {
+		for (i = 0; i < batch->numFiles; i++) {
+			if (batch->fileDescriptors[i] >= 0 && closed[i] < 0) {
+				close(batch->fileDescriptors[i]);
+			}
+		}
+		return -1;
+	}
+
+	// account for every file, finishing short writes by hand
+	for (i = 0; i < batch->numFiles; i++) {
+		if (batch->fileDescriptors[i] < 0) {
+			fprintf(stderr, "Could not open %s to write to file.\n", batch->fileNames[i]);
+			batch->numFailed++;
+			continue;
+		}
+		batch->numBytes += written[i] > 0 ? written[i] : 0;
+		if (written[i] >= 0 && (size_t)written[i] < batch->lengths[i] &&
+		    writeWholeText(batch, batch->fileDescriptors[i], batch->texts[i] + written[i],
+		                   batch->lengths[i] - written[i], written[i]) == 0) {
+			written[i] = batch->lengths[i];
+		}
+		if (closed[i] == -ECANCELED) {
+			closed[i] = close(batch->fileDescriptors[i]);
+			batch->numCalls++;
+		}
+		if (written[i] < 0 || (size_t)written[i] != batch->lengths[i] || closed[i] < 0) {
+			fprintf(stderr, "Could not write %s.\n", batch->fileNames[i]);
+			batch->numFailed++;
+		}
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: initFileBatch
+ * Description: Prepare an empty batch. With useRing set, an io_uring
+ *   instance is set up for it; if the kernel does not allow one, the batch
+ *   quietly writes with plain calls instead.
+ *****************************************************************************/
+void initFileBatch(struct FileBatch *batch, int useRing) {
+	initArena(&batch->arena, 64 * 1024);
+	batch->numFiles = 0;
+	batch->numFailed = 0;
+	batch->numCalls = 0;
+	batch->numBytes = 0;
+	batch->ring.ringFd = -1;
+	if (useRing) {
+		openFileRing(batch);
+	}
+}
+
+/******************************************************************************
+ * Function Name: addBatchFile
+ * Description: Queue a file to be created, or emptied if it exists, and
+ *   given the specified text. Its name and text are usually allocated from
+ *   the batch's arena, and must stay valid until the batch is flushed. A
+ *   batch that becomes full is flushed at once.
+ *****************************************************************************/
+void addBatchFile(struct FileBatch *batch, const char *fileName, const char *text, size_t length) {
+	batch->fileNames[batch->numFiles] = fileName;
+	batch->texts[batch->numFiles] = text;
+	batch->lengths[batch->numFiles] = length;
+	batch->numFiles++;
+	if (batch->numFiles == FILE_BATCH_SIZE) {
+		flushFileBatch(batch);
+	}
+}
+
+/******************************************************************************
+ * Function Name: flushFileBatch
+ * Description: Write every queued file, then empty the queue and reset the
+ *   arena. If the ring fails, it is given up and the whole batch is written
+ *   again with plain calls, which is safe because every open empties its
+ *   file. Returns 0 if every file written since the batch was prepared
+ *   succeeded, or -1.
+ *****************************************************************************/
+int flushFileBatch(struct FileBatch *batch) {
+	if (batch->numFiles > 0) {
+		if (batch->ring.ringFd == -1 || writeBatchRing(batch) == -1) {
+			closeFileRing(batch);
+			writeBatchPlain(batch);
+		}
+		batch->numFiles = 0;
+		resetArena(&batch->arena);
+	}
+	return batch->numFailed == 0 ? 0 : -1;
+}
+
+/******************************************************************************
+ * Function Name: freeFileBatch
+ * Description: Release the batch's arena and ring. Files still queued are
+ *   not written.
+ *****************************************************************************/
+void freeFileBatch(struct FileBatch *batch) {
+	closeFileRing(batch);
+	freeArena(&batch->arena);
+	batch->numFiles = 0;
+}
@@ -0,0 +1,70 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.filebatch.h
+ * Description: Batched writing of many small whole files, such as the text
+ *   room files of a world. Each file is formatted completely into the
+ *   batch's arena and queued; once FILE_BATCH_SIZE files are waiting they
+ *   are created, written, and closed together.
+ *
+ *   Where the kernel offers io_uring, a batch takes two submissions: one
+ *   opening every file, and one writing each file with its close linked
+ *   behind the write. A full batch then costs two system calls however many
+ *   files it holds. Where io_uring cannot be set up, each file is opened,
+ *   written with one call, and closed in turn, which is still one open per
+ *   file instead of creating it and opening it again to write.
+ *
+ *   A batch is not locked; each one must be used by one thread at a time.
+ *****************************************************************************/
+#ifndef GILESM_FILEBATCH_H
+#define GILESM_FILEBATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gilesm.arena.h"
+
+#define FILE_BATCH_SIZE 64					// files written together
+#define FILE_BATCH_MODE 0775				// permissions of new files
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+struct FileRing {
+	int ringFd;							// io_uring instance, or -1 without one
+	void *sqRing;						// mapped submission ring
+	size_t sqRingSize;					// bytes mapped for sqRing
+	void *cqRing;						// mapped completion ring, may equal sqRing
+	size_t cqRingSize;					// bytes mapped for cqRing
+	struct io_uring_sqe *sqes;			// mapped submission entries
+	size_t sqesSize;					// bytes mapped for sqes
+	unsigned int *sqTail;				// next submission slot, shared with the kernel
+	unsigned int *sqMask;				// submission ring size - 1
+	unsigned int *sqArray;				// entry each submission slot refers to
+	unsigned int *cqHead;				// next completion to reap, shared with the kernel
+	unsigned int *cqTail;				// end of the posted completions
+	unsigned int *cqMask;				// completion ring size - 1
+	struct io_uring_cqe *cqes;			// completion entries
+};
+
+struct FileBatch {
+	struct Arena arena;					// names and texts of the queued files
+	int numFiles;						// files queued
+	const char *fileNames[FILE_BATCH_SIZE];		// path of each queued file
+	const char *texts[FILE_BATCH_SIZE];			// whole contents of each file
+	size_t lengths[FILE_BATCH_SIZE];			// bytes in each text
+	int fileDescriptors[FILE_BATCH_SIZE];		// open file, or -1
+	int numFailed;						// files that could not be written
+	uint64_t numCalls;					// system calls made, ring setup included
+	uint64_t numBytes;					// bytes written to files
+	struct FileRing ring;				// io_uring used to write, if any
+};
+
+// prepare an empty batch, using io_uring if useRing is set and it is available
+void initFileBatch(struct FileBatch *batch, int useRing);
+// queue a file whose name and text stay valid until the batch is flushed
+void addBatchFile(struct FileBatch *batch, const char *fileName, const char *text, size_t length);
+// write every queued file and reset the arena, returns 0 on success or -1
+int flushFileBatch(struct FileBatch *batch);
+// release the batch's arena and ring without writing queued files
+void freeFileBatch(struct FileBatch *batch);
+
+#endif
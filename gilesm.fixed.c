@@ -0,0 +1,222 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.fixed.c
+ * Description: Fixed-size world engine described in gilesm.fixed.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "gilesm.adventure.h"
+#include "gilesm.fixed.h"
+#include "gilesm.stats.h"
+
+#if FIXED_ENGINE
+
+// every room's bit set
+#define FIXED_ALL_ROOMS (CLASSIC_ROOMS == 64 ? ~(uint64_t)0 : ((uint64_t)1 << CLASSIC_ROOMS) - 1)
+
+struct FixedBuilder {
+	uint64_t links[CLASSIC_ROOMS];				// bit of every room each room connects to
+	int numConn[CLASSIC_ROOMS];					// current connection count per room
+	int conns[CLASSIC_ROOMS][CLASSIC_MAX_CONN];	// connection slots per room
+	int numOpen;								// rooms with a free connection slot
+	int openRooms[CLASSIC_ROOMS];				// the numOpen rooms with a free slot
+	int openPosition[CLASSIC_ROOMS];			// index in openRooms per room, or -1
+};
+
+/******************************************************************************
+ * Function Name: fitsFixedEngine
+ * Description: Returns 1 if worlds built with the options, once initGame has
+ *   capped their connection bounds, have the classic shape the fixed engine
+ *   was compiled for, otherwise 0.
+ *****************************************************************************/
+int fitsFixedEngine(const struct GameOptions *options) {
+	int maxConn = (options->numRooms - 1 < options->maxConn) ? options->numRooms - 1 : options->maxConn,
+		minConn = (maxConn < options->minConn) ? maxConn : options->minConn;
+
+	return options->numRooms == CLASSIC_ROOMS && minConn == CLASSIC_MIN_CONN && maxConn == CLASSIC_MAX_CONN;
+}
+
+// record a one-way connection, closing the room once it is full, as addBuilderConn does
+static inline void addFixedConn(struct FixedBuilder *builder, int fromRoom, int toRoom) {
+	int position,
+		lastRoom;
+
+	builder->conns[fromRoom][builder->numConn[fromRoom]++] = toRoom;
+	builder->links[fromRoom] |= (uint64_t)1 << toRoom;
+	if (builder->numConn[fromRoom] == CLASSIC_MAX_CONN) {
+		position = builder->openPosition[fromRoom];
+		lastRoom = builder->openRooms[--builder->numOpen];
+		builder->openRooms[position] = lastRoom;
+		builder->openPosition[lastRoom] = position;
+		builder->openPosition[fromRoom] = -1;
+	}
+}
+
+// record a two-way connection, returns 0 with nothing recorded if either room refuses
+static inline int linkFixedRooms(struct FixedBuilder *builder, int firstRoom, int secondRoom) {
+	if (firstRoom == secondRoom ||
+	    builder->numConn[firstRoom] >= CLASSIC_MAX_CONN ||
+	    builder->numConn[secondRoom] >= CLASSIC_MAX_CONN ||
+	    ((builder->links[firstRoom] >> secondRoom) & 1)) {
+		return 0;
+	}
+	addFixedConn(builder, firstRoom, secondRoom);
+	addFixedConn(builder, secondRoom, firstRoom);
+	return 1;
+}
+
+/******************************************************************************
+ * Function Name: addFixedSpanningConns
+ * Description: Join every room with a random spanning tree, drawing the same
+ *   numbers as addSpanningConns: a shuffle into joining order, then one
+ *   parent per room from the tree rooms that still have a free slot. Timed
+ *   as addSpanningConns.
+ *****************************************************************************/
+static void addFixedSpanningConns(struct FixedBuilder *builder, struct Random *random) {
+	int order[CLASSIC_ROOMS],
+		frontier[CLASSIC_ROOMS],
+		numFrontier = 0,
+		i = 0,
+		j = 0,
+		swap,
+		position,
+		parent;
+	uint64_t start = startStatTimer();
+
+	// shuffle the rooms into a random joining order
+#pragma GCC unroll 64
+	for (i = 0; i < CLASSIC_ROOMS; i++) {
+		order[i] = i;
+	}
+#pragma GCC unroll 64
+	for (i = CLASSIC_ROOMS - 1; i > 0; i--) {
+		j = randomBelow(random, i + 1);
+		swap = order[i];
+		order[i] = order[j];
+		order[j] = swap;
+	}
+
+	// grow the tree one room at a time from the first room in the order
+	frontier[numFrontier++] = order[0];
+#pragma GCC unroll 64
+	for (i = 1; i < CLASSIC_ROOMS; i++) {
+		if (numFrontier == 0) {
+			break;
+		}
+		position = randomBelow(random, numFrontier);
+		parent = frontier[position];
+		linkFixedRooms(builder, parent, order[i]);
+		// retire the parent once it is full, keep the new room if it is not
+		if (builder->numConn[parent] >= CLASSIC_MAX_CONN) {
+			frontier[position] = frontier[--numFrontier];
+		}
+		if (builder->numConn[order[i]] < CLASSIC_MAX_CONN) {
+			frontier[numFrontier++] = order[i];
+		}
+	}
+	stopStatTimer(STAT_SPANNING_CONNS, start);
+}
+
+/******************************************************************************
+ * Function Name: addFixedRoomConn
+ * Description: Add a connection to a room as addRoomConn does: walk the open
+ *   rooms from a random starting point until one accepts. Timed and counted
+ *   as addRoomConn. Returns 1 if a connection was added or 0 if no room can
+ *   take one.
+ *****************************************************************************/
+static int addFixedRoomConn(struct FixedBuilder *builder, struct Random *random, int roomIndex) {
+	uint64_t timerStart = startStatTimer();
+	int start,
+		i = 0;
+
+	if (builder->numConn[roomIndex] >= CLASSIC_MAX_CONN || builder->numOpen < 2) {
+		countStat(STAT_CONN_FAILURES, 1);
+		stopStatTimer(STAT_ADD_ROOM_CONN, timerStart);
+		return 0;
+	}
+	start = randomBelow(random, builder->numOpen);
+	for (i = 0; i < builder->numOpen; i++) {
+		if (linkFixedRooms(builder, roomIndex, builder->openRooms[(start + i) % builder->numOpen])) {
+			countStat(STAT_CONN_REFUSALS, i);
+			stopStatTimer(STAT_ADD_ROOM_CONN, timerStart);
+			return 1;
+		}
+	}
+	countStat(STAT_CONN_REFUSALS, i);
+	countStat(STAT_CONN_FAILURES, 1);
+	stopStatTimer(STAT_ADD_ROOM_CONN, timerStart);
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: addFixedConns
+ * Description: Join the rooms of a classic world with a spanning tree, bring
+ *   each room up to the minimum, and pack the connections into the world,
+ *   all from a builder on the stack. Reachability is then checked with a
+ *   search whose frontier is a single word: each round or-s together the
+ *   links of every room reached so far. Returns 0, or -1 with nothing
+ *   packed if a room could not reach the minimum, which only a classic
+ *   shape whose rooms may not connect to every other room allows; the
+ *   runtime engine then builds the world and repairs that room.
+ *****************************************************************************/
+int addFixedConns(struct Game *currentGame) {
+	struct FixedBuilder builder;
+	uint64_t reached = 1,
+			 previous = 0;
+	int i = 0;
+
+	// every room starts open with no connections
+#pragma GCC unroll 64
+	for (i = 0; i < CLASSIC_ROOMS; i++) {
+		builder.links[i] = 0;
+		builder.numConn[i] = 0;
+		builder.openRooms[i] = i;
+		builder.openPosition[i] = i;
+	}
+	builder.numOpen = CLASSIC_ROOMS;
+
+	// join all rooms, then add connections to each room until it has the
+	// minimum, giving up if no other room can take one
+	addFixedSpanningConns(&builder, &currentGame->random);
+#pragma GCC unroll 64
+	for (i = 0; i < CLASSIC_ROOMS; i++) {
+		while (builder.numConn[i] < CLASSIC_MIN_CONN) {
+			if (!addFixedRoomConn(&builder, &currentGame->random, i)) {
+				return -1;
+			}
+		}
+	}
+	packRoomConns(&currentGame->world, builder.numConn, &builder.conns[0][0], CLASSIC_MAX_CONN);
+
+	// the spanning tree makes this impossible, but check as buildGame does
+	while (reached != previous) {
+		previous = reached;
+#pragma GCC unroll 64
+		for (i = 0; i < CLASSIC_ROOMS; i++) {
+			reached |= builder.links[i] & -((previous >> i) & 1);
+		}
+	}
+	if (reached != FIXED_ALL_ROOMS) {
+		fprintf(stderr, "Generated world is not connected.\n");
+		exit(1);
+	}
+	return 0;
+}
+
+#else
+
+// without the fixed engine no options fit it
+int fitsFixedEngine(const struct GameOptions *options) {
+	(void)options;
+	return 0;
+}
+
+// never called, since nothing fits
+int addFixedConns(struct Game *currentGame) {
+	(void)currentGame;
+	fprintf(stderr, "This build has no fixed engine.\n");
+	exit(1);
+}
+
+#endif
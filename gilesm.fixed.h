@@ -0,0 +1,31 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.fixed.h
+ * Description: World engine specialized at compile time for the classic
+ *   shape of gilesm.config.h. It makes exactly the random choices that
+ *   addSpanningConns and addRoomConn make, in the same order, so a seed
+ *   builds the same world with either engine; only the bookkeeping differs.
+ *   Each room's connections are one bit per room in a 64 bit word and a
+ *   row of CLASSIC_MAX_CONN slots, all on the stack, and every loop over
+ *   rooms or slots has a constant bound, so the compiler unrolls them and
+ *   nothing is allocated until the connections are packed into the world.
+ *
+ *   buildGame uses it for every world of the classic shape unless the
+ *   runtime engine is asked for; names, room types, the name index, and
+ *   everything after building are shared by both engines.
+ *****************************************************************************/
+#ifndef GILESM_FIXED_H
+#define GILESM_FIXED_H
+
+#include "gilesm.config.h"
+
+struct Game;
+struct GameOptions;
+
+// returns 1 if the fixed engine can build worlds with these options, otherwise 0
+int fitsFixedEngine(const struct GameOptions *options);
+// join the rooms of a classic world and pack their connections into it,
+// returns 0, or -1 if a room is left short for the runtime engine to build
+int addFixedConns(struct Game *currentGame);
+
+#endif
@@ -0,0 +1,348 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.fuzz.c
+ * Description: Parallel world fuzzer described in gilesm.fuzz.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "gilesm.adventure.h"
+#include "gilesm.fuzz.h"
+
+struct FuzzJob {
+	const struct FuzzConfig *config;	// settings for the whole run
+	const char *dirName;				// directory holding each thread's files
+	int nextWorld;						// next world not yet claimed
+	int nextThread;						// number of the next thread to start
+	int numFailed;						// worlds that broke an invariant
+};
+
+// seed world k of a run is built from
+static uint64_t getFuzzSeed(const struct FuzzConfig *config, int worldNumber) {
+	return config->useWorldSeed ? config->seed : mixRandomSeed(config->seed, worldNumber);
+}
+
+/******************************************************************************
+ * Function Name: checkGraph
+ * Description: Check every room's connections for rooms out of range, rooms
+ *   connecting to themselves or twice to the same room, connections with no
+ *   way back, and degrees outside the game's bounds, then check that every
+ *   room is reachable. Small worlds do this with a room matrix from the
+ *   game's arena; larger ones scan the connection lists. Returns NULL or a
+ *   description of the first failure.
+ *****************************************************************************/
+static const char *checkGraph(struct Game *currentGame, char *message, size_t size) {
+	const struct World *world = &currentGame->world;
+	struct RoomMatrix matrix;
+	int small = initRoomMatrix(&matrix, world->numRooms, &currentGame->arena) == 0,
+		i = 0,
+		j = 0,
+		k = 0;
+
+	for (i = 0; i < world->numRooms; i++) {
+		const int *conns = getConns(world, i);
+		if (getNumConns(world, i) < currentGame->minConn || getNumConns(world, i) > currentGame->builder.maxConn) {
+			snprintf(message, size, "room %d has %d connections, outside %d to %d", i,
+			         getNumConns(world, i), currentGame->minConn, currentGame->builder.maxConn);
+			return message;
+		}
+		for (j = 0; j < getNumConns(world, i); j++) {
+			if (conns[j] < 0 || conns[j] >= world->numRooms) {
+				snprintf(message, size, "room %d connects to missing room %d", i, conns[j]);
+				return message;
+			}
+			if (conns[j] == i) {
+				snprintf(message, size, "room %d connects to itself", i);
+				return message;
+			}
+			if (small) {
+				continue;
+			}
+			for (k = 0; k < j; k++) {
+				if (conns[k] == conns[j]) {
+					snprintf(message, size, "room %d connects to room %d twice", i, conns[j]);
+					return message;
+				}
+			}
+			if (!isConnected(world, conns[j], i)) {
+				snprintf(message, size, "room %d connects to room %d but not back", i, conns[j]);
+				return message;
+			}
+		}
+	}
+	if (small) {
+		// every connection is in range, so the whole graph fits the matrix
+		fillRoomMatrix(&matrix, world);
+		for (i = 0; i < world->numRooms; i++) {
+			// a room listed twice sets its bit once
+			if (countMatrixConns(&matrix, i) != getNumConns(world, i)) {
+				snprintf(message, size, "room %d lists a room twice", i);
+				return message;
+			}
+		}
+	}
+	if (small && !isMatrixSymmetric(&matrix)) {
+		snprintf(message, size, "a connection has no way back");
+		return message;
+	}
+	if (small ? countMatrixReachable(&matrix, world->startRoomIndex) != world->numRooms :
+	            countWorldRegions(world) != 1) {
+		snprintf(message, size, "some rooms cannot be reached from the start room");
+		return message;
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Function Name: checkWorldInvariants
+ * Description: Check a world built by buildGame: start and end rooms lie in
+ *   the world and differ, its graph holds (see checkGraph), and every room
+ *   has a name that the name index finds for that room alone. Returns NULL
+ *   if the world holds, or the message buffer describing the first failure.
+ *****************************************************************************/
+const char *checkWorldInvariants(struct Game *currentGame, char *message, size_t size) {
+	const struct World *world = &currentGame->world;
+	int i = 0;
+
+	if (world->startRoomIndex < 0 || world->startRoomIndex >= world->numRooms ||
+	    world->endRoomIndex < 0 || world->endRoomIndex >= world->numRooms) {
+		snprintf(message, size, "start room %d or end room %d is missing",
+		         world->startRoomIndex, world->endRoomIndex);
+		return message;
+	}
+	if (world->startRoomIndex == world->endRoomIndex) {
+		snprintf(message, size, "start and end are both room %d", world->startRoomIndex);
+		return message;
+	}
+	if (checkGraph(currentGame, message, size) != NULL) {
+		return message;
+	}
+	// a name shared by two rooms finds the same room for both
+	for (i = 0; i < world->numRooms; i++) {
+		if (world->roomList[i].nameLength == 0 ||
+		    findRoom(world, getRoomName(world, i), world->roomList[i].nameLength) != i) {
+			snprintf(message, size, "room %d has an empty or repeated name \"%s\"", i, getRoomName(world, i));
+			return message;
+		}
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Function Name: checkRoomFiles
+ * Description: Format every room as its text file with formatRoomFile, parse
+ *   them all back into the emptied builder with parseRoomFile, and check
+ *   that each room returns with its name, type, and connections in the same
+ *   order. If onDisk is set the text goes through real files instead, with
+ *   writeRoomFile and readRoomFile in the game directory. Returns NULL or a
+ *   failure description.
+ *****************************************************************************/
+static const char *checkRoomFiles(struct Game *currentGame, int onDisk, char *message, size_t size) {
+	struct World *world = &currentGame->world;
+	struct WorldBuilder *builder = &currentGame->builder;
+	int *nameOffsets = allocArena(&currentGame->arena, sizeof(int) * world->numRooms),
+		*types = allocArena(&currentGame->arena, sizeof(int) * world->numRooms),
+		i = 0;
+	char **texts = NULL;
+	size_t *lengths = NULL;
+
+	if (!onDisk) {
+		texts = allocArena(&currentGame->arena, sizeof(char *) * world->numRooms);
+		lengths = allocArena(&currentGame->arena, sizeof(size_t) * world->numRooms);
+	}
+	for (i = 0; i < world->numRooms; i++) {
+		nameOffsets[i] = world->roomList[i].nameOffset;
+		types[i] = world->roomList[i].type;
+		if (onDisk) {
+			createRoomFile(currentGame, i);
+			writeRoomFile(currentGame, i);
+		} else {
+			texts[i] = formatRoomFile(world, i, &currentGame->scratch, &lengths[i]);
+		}
+	}
+	clearWorldBuilder(builder);
+	for (i = 0; i < world->numRooms; i++) {
+		if (onDisk) {
+			readRoomFile(currentGame, i);
+		} else {
+			parseRoomFile(currentGame, i, texts[i], lengths[i]);
+		}
+	}
+	resetArena(&currentGame->scratch);
+	for (i = 0; i < world->numRooms; i++) {
+		if (strcmp(world->namePool + nameOffsets[i], getRoomName(world, i)) != 0) {
+			snprintf(message, size, "room %d came back from its file as \"%s\"", i, getRoomName(world, i));
+			return message;
+		}
+		if (world->roomList[i].type != types[i]) {
+			snprintf(message, size, "room %d came back from its file with type %d", i, world->roomList[i].type);
+			return message;
+		}
+		if (builder->numConn[i] != getNumConns(world, i) ||
+		    memcmp(builder->conns + (size_t)i * builder->maxConn, getConns(world, i),
+		           sizeof(int) * getNumConns(world, i)) != 0) {
+			snprintf(message, size, "room %d came back from its file with %d of %d connections changed",
+			         i, builder->numConn[i], getNumConns(world, i));
+			return message;
+		}
+	}
+	return NULL;
+}
+
+/******************************************************************************
+ * Function Name: checkEngines
+ * Description: Build a world the fixed engine built again with the runtime
+ *   engine, in the spare game given, and check that both engines made the
+ *   same world. Returns NULL or a failure description.
+ *****************************************************************************/
+static const char *checkEngines(struct Game *currentGame, struct Game *spareGame,
+                                const struct FuzzConfig *config, uint64_t seed, char *message, size_t size) {
+	struct GameOptions options = config->options;
+	const char *result = NULL;
+
+	if (!currentGame->fixedEngine) {
+		return NULL;
+	}
+	options.engine = ENGINE_RUNTIME;
+	initGame(spareGame, &options, seed);
+	buildGame(spareGame);
+	if (hashWorld(&spareGame->world) != hashWorld(&currentGame->world)) {
+		snprintf(message, size, "the fixed and runtime engines built different worlds");
+		result = message;
+	}
+	freeGame(spareGame);
+	return result;
+}
+
+/******************************************************************************
+ * Function Name: fuzzThread
+ * Description: Worker thread body. Claims the next unchecked world until
+ *   none remain, builds it from its seed, checks its invariants and, for a
+ *   classic world, that the runtime engine builds it the same, and round
+ *   trips it through room file text in memory, or for every
+ *   FUZZ_FILE_SAMPLE-th world through room files in the thread's own
+ *   directory. Failing worlds are reported with their seeds, up to
+ *   FUZZ_REPORT_LIMIT of them.
+ *****************************************************************************/
+static void *fuzzThread(void *arg) {
+	struct FuzzJob *job = arg;
+	const struct FuzzConfig *config = job->config;
+	struct Game *currentGame = malloc(sizeof(struct Game)),
+				*spareGame = malloc(sizeof(struct Game));
+	char dirPath[sizeof(currentGame->dirPath)],
+		 fileName[sizeof(dirPath) + 32],
+		 message[256];
+	int threadNumber = __atomic_fetch_add(&job->nextThread, 1, __ATOMIC_RELAXED),
+		worldNumber,
+		numFailed,
+		i = 0;
+
+	if (currentGame == NULL || spareGame == NULL) {
+		fprintf(stderr, "Could not allocate a game.\n");
+		exit(1);
+	}
+	snprintf(dirPath, sizeof(dirPath), "%s/thread%d", job->dirName, threadNumber);
+	mkdir(dirPath, 0775);
+	while ((worldNumber = __atomic_fetch_add(&job->nextWorld, 1, __ATOMIC_RELAXED)) < config->numWorlds) {
+		initGame(currentGame, &config->options, getFuzzSeed(config, worldNumber));
+		strcpy(currentGame->dirPath, dirPath);
+		buildGame(currentGame);
+		if (checkWorldInvariants(currentGame, message, sizeof(message)) != NULL ||
+		    checkEngines(currentGame, spareGame, config, getFuzzSeed(config, worldNumber), message,
+		                 sizeof(message)) != NULL ||
+		    checkRoomFiles(currentGame, worldNumber % FUZZ_FILE_SAMPLE == 0, message, sizeof(message)) != NULL) {
+			numFailed = __atomic_fetch_add(&job->numFailed, 1, __ATOMIC_RELAXED);
+			if (numFailed < FUZZ_REPORT_LIMIT) {
+				fprintf(stderr, "world %d (seed %llu) failed: %s\n", worldNumber,
+				        (unsigned long long)getFuzzSeed(config, worldNumber), message);
+			}
+		}
+		freeGame(currentGame);
+	}
+
+	// leave nothing behind in the thread's directory
+	for (i = 0; i < config->options.numRooms && config->numWorlds > 0; i++) {
+		snprintf(fileName, sizeof(fileName), "%s/file%d", dirPath, i);
+		unlink(fileName);
+	}
+	rmdir(dirPath);
+	free(spareGame);
+	free(currentGame);
+	return NULL;
+}
+
+/******************************************************************************
+ * Function Name: runFuzz
+ * Description: Build and check every world of a fuzz run on the requested
+ *   number of threads, one per core by default, then print how many failed
+ *   and the throughput per core. The room files go in the named directory,
+ *   or in a per-process one that is removed afterwards. Returns the process
+ *   exit status, 1 if any world failed.
+ *****************************************************************************/
+int runFuzz(const struct FuzzConfig *config) {
+	struct FuzzJob job;
+	struct timespec startTime,
+					endTime;
+	pthread_t *threads;
+	char dirName[64];
+	double seconds;
+	int numThreads = config->numThreads,
+		i = 0;
+
+	if (numThreads <= 0) {
+		numThreads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+	}
+	job.config = config;
+	job.nextWorld = 0;
+	job.nextThread = 0;
+	job.numFailed = 0;
+	job.dirName = config->dirName;
+	if (job.dirName == NULL) {
+		snprintf(dirName, sizeof(dirName), "gilesm.fuzz.%d", (int)getpid());
+		job.dirName = dirName;
+	}
+	mkdir(job.dirName, 0775);
+	threads = malloc(sizeof(pthread_t) * numThreads);
+	if (threads == NULL) {
+		fprintf(stderr, "Could not allocate %d threads.\n", numThreads);
+		return 1;
+	}
+
+	// check the worlds on every thread, the calling thread included
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+	for (i = 1; i < numThreads; i++) {
+		if (pthread_create(&threads[i], NULL, fuzzThread, &job) != 0) {
+			fprintf(stderr, "Could not start fuzz thread %d.\n", i);
+			numThreads = i;
+			break;
+		}
+	}
+	fuzzThread(&job);
+	for (i = 1; i < numThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+	seconds = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+	if (config->dirName == NULL) {
+		rmdir(job.dirName);
+	}
+
+	printf("checked %d worlds of %d rooms with %d threads in %.3f s, %d failed\n",
+	       config->numWorlds, config->options.numRooms, numThreads, seconds, job.numFailed);
+	printf("%.1f worlds/sec, %.1f worlds/sec per core\n",
+	       seconds > 0 ? config->numWorlds / seconds : 0.0,
+	       seconds > 0 ? config->numWorlds / seconds / numThreads : 0.0);
+	if (job.numFailed > 0) {
+		fprintf(stderr, "replay a failing world with --check-seed SEED --rooms %d --min-conn %d --max-conn %d"
+		        " --engine %s\n", config->options.numRooms, config->options.minConn, config->options.maxConn,
+		        getGameEngineName(config->options.engine));
+	}
+
+	free(threads);
+	return job.numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.fuzz.h
+ * Description: Parallel world fuzzer. Builds many worlds across a pool of
+ *   threads, as a generation run does, and checks every one of them against
+ *   the invariants a playable world must keep: start and end differ, every
+ *   connection leads back, no room connects to itself or twice to the same
+ *   room, every room's degree is within the configured bounds, the end is
+ *   reachable, and every name is unique. A classic world built by the fixed
+ *   engine must also come out the same from the runtime engine. Each world
+ *   is then formatted as room file text and parsed back in memory, and must
+ *   come back with the same names, types, and connections. Every
+ *   FUZZ_FILE_SAMPLE-th world makes that round trip through real room files
+ *   with writeRoomFile and readRoomFile instead, so the file handling is
+ *   covered without the disk setting the pace of the whole run.
+ *
+ *   World k is seeded with stream k of the base seed, and a failing world is
+ *   reported with the seed it was built from, so it can be checked again on
+ *   its own with --check-seed or played with --seed.
+ *****************************************************************************/
+#ifndef GILESM_FUZZ_H
+#define GILESM_FUZZ_H
+
+#include <stdint.h>
+#include "gilesm.adventure.h"
+
+#define FUZZ_REPORT_LIMIT 20				// failing worlds listed, the rest counted
+#define FUZZ_FILE_SAMPLE 1024				// one world in this many goes through real files
+
+struct FuzzConfig {
+	int numWorlds;						// number of worlds to build and check
+	struct GameOptions options;			// settings for each world
+	int numThreads;						// threads checking worlds, 0 for one per core
+	uint64_t seed;						// base seed, world k uses stream k
+	int useWorldSeed;					// build one world from seed itself instead
+	const char *dirName;				// directory for room files, or NULL
+};
+
+// check one built world, returns NULL if it holds or a description of the failure
+const char *checkWorldInvariants(struct Game *currentGame, char *message, size_t size);
+// build and check every world of a fuzz run, returns the process exit status
+int runFuzz(const struct FuzzConfig *config);
+
+#endif
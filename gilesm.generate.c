@@ -0,0 +1,124 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.generate.c
+ * Description: Parallel world generation described in gilesm.generate.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "gilesm.adventure.h"
+#include "gilesm.worldfile.h"
+#include "gilesm.generate.h"
+
+struct GenerateJob {
+	const struct GenerateConfig *config;	// settings for the whole run
+	unsigned long long *fingerprints;	// hashWorld of each world, in order
+	int nextWorld;						// next world not yet claimed
+	int numFailed;						// worlds whose file was not written
+};
+
+/******************************************************************************
+ * Function Name: generateThread
+ * Description: Worker thread body. Claims the next unbuilt world until none
+ *   remain, builds it from its own stream of the base seed, records its
+ *   fingerprint, and writes its world file if an output directory was given.
+ *****************************************************************************/
+static void *generateThread(void *arg) {
+	struct GenerateJob *job = arg;
+	const struct GenerateConfig *config = job->config;
+	struct Game *currentGame = malloc(sizeof(struct Game));
+	char fileName[512];
+	int worldNumber;
+
+	if (currentGame == NULL) {
+		fprintf(stderr, "Could not allocate a game.\n");
+		exit(1);
+	}
+	while ((worldNumber = __atomic_fetch_add(&job->nextWorld, 1, __ATOMIC_RELAXED)) < config->numWorlds) {
+		initGame(currentGame, &config->options, mixRandomSeed(config->seed, worldNumber));
+		buildGame(currentGame);
+		job->fingerprints[worldNumber] = hashWorld(&currentGame->world);
+		if (config->outDirName != NULL) {
+			snprintf(fileName, sizeof(fileName), "%s/world.%d", config->outDirName, worldNumber);
+			if (writeWorldFile(&currentGame->world, fileName) == -1) {
+				__atomic_fetch_add(&job->numFailed, 1, __ATOMIC_RELAXED);
+			}
+		}
+		freeGame(currentGame);
+	}
+	free(currentGame);
+	return NULL;
+}
+
+/******************************************************************************
+ * Function Name: runGenerate
+ * Description: Build every world of a generation run on the requested number
+ *   of threads, then print the run's digest and throughput. The digest
+ *   combines the world fingerprints in world order, so it only depends on
+ *   the seed, world count, and world options. Returns the process exit status.
+ *****************************************************************************/
+int runGenerate(const struct GenerateConfig *config) {
+	struct GenerateJob job;
+	struct timespec startTime,
+					endTime;
+	pthread_t *threads;
+	unsigned long long digest = 14695981039346656037ULL;
+	double seconds;
+	int numThreads = config->numThreads > 0 ? config->numThreads : 1,
+		i = 0;
+
+	job.config = config;
+	job.fingerprints = calloc(config->numWorlds, sizeof(unsigned long long));
+	job.nextWorld = 0;
+	job.numFailed = 0;
+	threads = malloc(sizeof(pthread_t) * numThreads);
+	if (job.fingerprints == NULL || threads == NULL) {
+		fprintf(stderr, "Could not allocate %d worlds.\n", config->numWorlds);
+		return 1;
+	}
+	if (config->outDirName != NULL) {
+		mkdir(config->outDirName, 0775);
+	}
+
+	// build the worlds on every thread, the calling thread included
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+	for (i = 1; i < numThreads; i++) {
+		if (pthread_create(&threads[i], NULL, generateThread, &job) != 0) {
+			fprintf(stderr, "Could not start generation thread %d.\n", i);
+			numThreads = i;
+			break;
+		}
+	}
+	generateThread(&job);
+	for (i = 1; i < numThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &endTime);
+	seconds = (endTime.tv_sec - startTime.tv_sec) + (endTime.tv_nsec - startTime.tv_nsec) / 1e9;
+
+	// combine the fingerprints in world order
+	for (i = 0; i < config->numWorlds; i++) {
+		int byte = 0;
+		for (byte = 0; byte < 8; byte++) {
+			digest = (digest ^ ((job.fingerprints[i] >> (byte * 8)) & 0xff)) * 1099511628211ULL;
+		}
+	}
+
+	printf("generated %d worlds of %d rooms with %d threads in %.3f s\n",
+	       config->numWorlds, config->options.numRooms, numThreads, seconds);
+	printf("%.1f worlds/sec, %.1f worlds/sec per thread\n",
+	       seconds > 0 ? config->numWorlds / seconds : 0.0,
+	       seconds > 0 ? config->numWorlds / seconds / numThreads : 0.0);
+	printf("seed %llu digest %016llx\n", (unsigned long long)config->seed, digest);
+	if (job.numFailed > 0) {
+		fprintf(stderr, "%d world files could not be written.\n", job.numFailed);
+	}
+
+	free(job.fingerprints);
+	free(threads);
+	return job.numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.generate.h
+ * Description: Parallel world generation. Builds many worlds at once across a
+ *   pool of threads. World k is always seeded with stream k of the base
+ *   seed, whichever thread builds it, so the worlds produced for a seed are
+ *   bit-for-bit the same for any number of threads. Each world is reduced to
+ *   a fingerprint, and the fingerprints are combined in world order into one
+ *   digest that can be compared between runs.
+ *****************************************************************************/
+#ifndef GILESM_GENERATE_H
+#define GILESM_GENERATE_H
+
+#include <stdint.h>
+#include "gilesm.adventure.h"
+
+struct GenerateConfig {
+	int numWorlds;						// number of worlds to build
+	struct GameOptions options;			// settings for each world
+	int numThreads;						// threads building worlds
+	uint64_t seed;						// base seed, world k uses stream k
+	const char *outDirName;				// directory for world files, or NULL
+};
+
+// build every world of a generation run, returns the process exit status
+int runGenerate(const struct GenerateConfig *config);
+
+#endif
@@ -0,0 +1,331 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.main.c
+ * Description: Command line entry point. Reads the options, then plays an
+ *   interactive game (gilesm.adventure.c), a headless batch of games
+ *   (gilesm.batch.c), a parallel generation run (gilesm.generate.c), a
+ *   parallel fuzz run checking generated worlds (gilesm.fuzz.c), or a replay
+ *   of logged games (gilesm.tracelog.c).
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "gilesm.adventure.h"
+#include "gilesm.worldfile.h"
+#include "gilesm.worldshm.h"
+#include "gilesm.batch.h"
+#include "gilesm.generate.h"
+#include "gilesm.fuzz.h"
+#include "gilesm.server.h"
+#include "gilesm.stream.h"
+#include "gilesm.stats.h"
+#include "gilesm.tracelog.h"
+
+/******************************************************************************
+ * Function Name: chooseWorld
+ * Description: Give a game its world: attach to one published in shared
+ *   memory, map one from a world file, or build a new one, in that order of
+ *   preference.
+ *****************************************************************************/
+static void chooseWorld(struct Game *currentGame, const char *shmName, const char *worldFileName) {
+	if (shmName != NULL) {
+		attachGame(currentGame, shmName);
+	} else if (worldFileName != NULL) {
+		loadGame(currentGame, worldFileName);
+	} else {
+		buildGame(currentGame);
+	}
+}
+
+/******************************************************************************
+ * Function Name: publishAndWait
+ * Description: Publish a world in shared memory and keep it published until
+ *   SIGINT or SIGTERM, then retire it. Returns the process exit status.
+ *****************************************************************************/
+static int publishAndWait(const struct World *world, const char *shmName) {
+	sigset_t signalSet;
+	int signalNumber;
+
+	// take the signals here instead of letting them end the process
+	sigemptyset(&signalSet);
+	sigaddset(&signalSet, SIGINT);
+	sigaddset(&signalSet, SIGTERM);
+	sigprocmask(SIG_BLOCK, &signalSet, NULL);
+	if (publishWorld(world, shmName) == -1) {
+		return 1;
+	}
+	printf("published %d rooms as %s until interrupted\n", world->numRooms, shmName);
+	fflush(stdout);
+	sigwait(&signalSet, &signalNumber);
+	return retireWorld(shmName) == -1 ? 1 : 0;
+}
+
+/******************************************************************************
+ * Function Name: playRoomSource
+ * Description: Play a world read room by room from a source through a room
+ *   cache instead of held in memory, then report how well the cache did on
+ *   stderr and close the source. The route is scored against shortestSteps
+ *   unless it is -1. Returns the process exit status.
+ *****************************************************************************/
+static int playRoomSource(const struct GameOptions *options, uint64_t seed, struct RoomSource *source,
+                          int cacheRooms, int shortestSteps) {
+	struct RoomCache cache;
+	struct Game *currentGame;
+
+	initRoomCache(&cache, source, cacheRooms);
+	// the game only keeps the step list, its own world is never played
+	currentGame = (struct Game *)malloc(sizeof(struct Game));
+	initGame(currentGame, options, seed);
+	playCachedGame(currentGame, &cache);
+	displayCachedResults(currentGame, &cache, shortestSteps);
+	fprintf(stderr, "room cache: %ld hits, %ld misses, %ld evictions, %d of %d rooms held\n",
+	        cache.numHits, cache.numMisses, cache.numEvictions, cache.numSlots, cache.capacity);
+	freeGame(currentGame);
+	free(currentGame);
+	freeRoomCache(&cache);
+	closeRoomSource(source);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	// initialize game structure and allocate memory
+	struct Game *currentGame;
+	struct BatchConfig batch;	// settings for headless games
+	struct GenerateConfig generate;	// settings for parallel generation
+	struct FuzzConfig fuzz;		// settings for checking generated worlds
+	struct ServerConfig server;	// settings for the game server
+	struct GameOptions options;	// settings for the world
+	struct NameList nameList;	// room names read from a dictionary file
+	struct RoomSource source;	// world read room by room instead of loaded
+	struct TraceLog traceLog;	// shared log the game is recorded in
+	enum StatFormat statFormat;	// how the --stats report is printed
+	uint64_t seed = getTimeSeed();	// seed for the random streams
+	int i = 0,
+		exportText = 0,			// write text room files for debugging
+		saveWorld = 1,			// write the binary world file
+		hintTable = 0,			// record every distance to the end room up front
+		lazy = 0,				// read rooms on demand from the world file
+		stream = 0,				// generate rooms on demand as they are reached
+		goalDistance = STREAM_GOAL_DISTANCE,	// moves to the streaming end room
+		cacheRooms = ROOM_CACHE_SIZE;	// rooms held by the lazy room cache
+	char *worldFileName = NULL,	// existing world file to play instead
+		 *attachName = NULL,	// shared world to play instead
+		 *publishName = NULL,	// shared memory name to publish the world as
+		 *traceFileName = NULL,	// binary step trace to write at the end
+		 *traceLogName = NULL,	// shared log to append the games to
+		 *replayLogName = NULL;	// shared log to replay instead of playing
+	// read the optional settings from the command line
+	initGameOptions(&options);
+	memset(&batch, 0, sizeof(batch));
+	batch.policyName = "random";
+	batch.maxMoves = 1000000;
+	memset(&generate, 0, sizeof(generate));
+	memset(&fuzz, 0, sizeof(fuzz));
+	memset(&server, 0, sizeof(server));
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--rooms") == 0 && i + 1 < argc) {
+			options.numRooms = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--min-conn") == 0 && i + 1 < argc) {
+			options.minConn = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--max-conn") == 0 && i + 1 < argc) {
+			options.maxConn = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--names") == 0 && i + 1 < argc) {
+			if (loadNameList(&nameList, argv[++i]) == -1) {
+				exit(1);
+			}
+			options.nameList = &nameList;
+		} else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+			if (parseGameEngine(argv[++i], &options.engine) == -1) {
+				exit(1);
+			}
+		} else if (strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+			worldFileName = argv[++i];
+		} else if (strcmp(argv[i], "--lazy") == 0) {
+			lazy = 1;
+		} else if (strcmp(argv[i], "--cache-rooms") == 0 && i + 1 < argc) {
+			cacheRooms = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--stream") == 0) {
+			stream = 1;
+		} else if (strcmp(argv[i], "--goal-distance") == 0 && i + 1 < argc) {
+			goalDistance = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--attach") == 0 && i + 1 < argc) {
+			attachName = argv[++i];
+		} else if (strcmp(argv[i], "--publish") == 0 && i + 1 < argc) {
+			publishName = argv[++i];
+		} else if (strcmp(argv[i], "--unpublish") == 0 && i + 1 < argc) {
+			return retireWorld(argv[++i]) == -1 ? 1 : 0;
+		} else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			traceFileName = argv[++i];
+		} else if (strcmp(argv[i], "--trace-log") == 0 && i + 1 < argc) {
+			traceLogName = argv[++i];
+		} else if (strcmp(argv[i], "--replay-log") == 0 && i + 1 < argc) {
+			replayLogName = argv[++i];
+		} else if (strcmp(argv[i], "--export-text") == 0) {
+			exportText = 1;
+		} else if (strcmp(argv[i], "--hint-table") == 0) {
+			hintTable = 1;
+		} else if (strcmp(argv[i], "--no-save") == 0) {
+			saveWorld = 0;
+		} else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+			batch.numGames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+			batch.policyName = argv[++i];
+		} else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+			batch.scriptFileName = argv[++i];
+		} else if (strcmp(argv[i], "--max-moves") == 0 && i + 1 < argc) {
+			batch.maxMoves = atol(argv[++i]);
+		} else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 0);
+		} else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+			generate.numWorlds = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+			fuzz.numWorlds = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--check-seed") == 0 && i + 1 < argc) {
+			seed = strtoull(argv[++i], NULL, 0);
+			fuzz.numWorlds = 1;
+			fuzz.useWorldSeed = 1;
+		} else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			generate.numThreads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			generate.outDirName = argv[++i];
+		} else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+			server.socketName = argv[++i];
+		} else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+			if (parseStatFormat(argv[++i], &statFormat) == -1) {
+				exit(1);
+			}
+			enableStats(statFormat);
+		} else {
+			fprintf(stderr, "usage: %s [--rooms N] [--min-conn N] [--max-conn N] [--seed S]\n"
+			                "       [--engine auto|fixed|runtime]\n"
+			                "       [--names FILE] [--world FILE | --attach SHM] [--export-text] [--no-save]\n"
+			                "       [--trace FILE] [--trace-log FILE] [--replay-log FILE]\n"
+			                "       [--hint-table] [--lazy [--cache-rooms N]]\n"
+			                "       [--stream [--goal-distance N] [--cache-rooms N]]\n"
+			                "       [--batch GAMES [--policy random|greedy|bfs|replay]\n"
+			                "        [--script FILE] [--max-moves N]]\n"
+			                "       [--generate WORLDS [--threads N] [--out DIR]]\n"
+			                "       [--fuzz WORLDS [--threads N] [--out DIR] | --check-seed S]\n"
+			                "       [--serve SOCKET [--threads N]]\n"
+			                "       [--publish SHM] [--unpublish SHM] [--stats text|json]\n", argv[0]);
+			exit(1);
+		}
+	}
+	if (checkGameOptions(&options) == -1) {
+		exit(1);
+	}
+	// replay logged games instead of playing when asked
+	if (replayLogName != NULL) {
+		return runTraceReplay(replayLogName, &options);
+	}
+	// a logged game is replayed by building its world again
+	if (traceLogName != NULL && (worldFileName != NULL || attachName != NULL || lazy || stream)) {
+		fprintf(stderr, "--trace-log records only games in worlds built from a seed.\n");
+		exit(1);
+	}
+	// generate worlds in parallel instead of playing when asked
+	if (generate.numWorlds > 0) {
+		generate.options = options;
+		generate.seed = seed;
+		return runGenerate(&generate);
+	}
+	// build worlds and check their invariants instead of playing when asked
+	if (fuzz.numWorlds > 0) {
+		fuzz.options = options;
+		fuzz.seed = seed;
+		fuzz.numThreads = generate.numThreads;
+		fuzz.dirName = generate.outDirName;
+		return runFuzz(&fuzz);
+	}
+	// run headless games instead of an interactive one when asked
+	if (batch.numGames > 0) {
+		batch.options = options;
+		batch.seed = seed;
+		batch.worldFileName = worldFileName;
+		batch.traceLogName = traceLogName;
+		return runBatch(&batch);
+	}
+	// serve one world to players over a socket when asked
+	if (server.socketName != NULL) {
+		server.numThreads = generate.numThreads;
+		currentGame = (struct Game *)malloc(sizeof(struct Game));
+		initGame(currentGame, &options, seed);
+		chooseWorld(currentGame, attachName, worldFileName);
+		i = runServer(&currentGame->world, &server);
+		freeGame(currentGame);
+		free(currentGame);
+		return i;
+	}
+	// play a world file too large to load, reading rooms only as they are visited
+	if (lazy) {
+		if (worldFileName == NULL) {
+			fprintf(stderr, "--lazy needs a world file named with --world.\n");
+			exit(1);
+		}
+		if (openFileRoomSource(&source, worldFileName) == -1) {
+			exit(1);
+		}
+		return playRoomSource(&options, seed, &source, cacheRooms, -1);
+	}
+	// play an endless world generated as it is explored
+	if (stream) {
+		if (openStreamRoomSource(&source, seed, goalDistance, options.nameList) == -1) {
+			exit(1);
+		}
+		return playRoomSource(&options, seed, &source, cacheRooms, goalDistance);
+	}
+	// keep one world in shared memory for other games to attach to when asked
+	if (publishName != NULL) {
+		currentGame = (struct Game *)malloc(sizeof(struct Game));
+		initGame(currentGame, &options, seed);
+		chooseWorld(currentGame, NULL, worldFileName);
+		i = publishAndWait(&currentGame->world, publishName);
+		freeGame(currentGame);
+		free(currentGame);
+		return i;
+	}
+	// initialize the game attributes and room name list
+	currentGame = (struct Game *)malloc(sizeof(struct Game));
+	initGame(currentGame, &options, seed);
+	// play a shared or saved world, or assign room names and room connections
+	chooseWorld(currentGame, attachName, worldFileName);
+	// answer hints with a lookup instead of a search when asked
+	currentGame->precomputePaths = hintTable;
+	if (hintTable) {
+		getGameOracle(currentGame);
+	}
+	// save a generated world and any text room files while the game runs,
+	// creating the game directory only if something will be written to it
+	currentGame->saveWorld = saveWorld && worldFileName == NULL && attachName == NULL;
+	currentGame->exportText = exportText;
+	if (currentGame->saveWorld || currentGame->exportText) {
+		initGameDir(currentGame);
+	}
+	saveGame(currentGame);
+	// record the game in the shared log when asked
+	if (traceLogName != NULL) {
+		if (openTraceLog(&traceLog, traceLogName) == -1) {
+			exit(1);
+		}
+		currentGame->traceLog = &traceLog;
+	}
+	// allow player to play game until end room is reached
+	playGame(currentGame);
+    // display congratulations, step count, and step history path to the user
+	displayGameResults(currentGame);
+	// keep the path taken when asked
+	if (traceFileName != NULL) {
+		writeStepTrace(&currentGame->world, currentGame->seed, currentGame->stepList,
+		               currentGame->stepCount, traceFileName);
+	}
+	if (traceLogName != NULL) {
+		closeTraceLog(&traceLog);
+	}
+	// clean game data once the world files are written
+	freeGame(currentGame);
+	free(currentGame); 
+    
+	// exit with value 0
+    return 0;
+}
@@ -0,0 +1,269 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.names.c
+ * Description: Room name dictionaries described in gilesm.names.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "gilesm.world.h"
+#include "gilesm.names.h"
+
+// names of the classic game, used when no dictionary is given
+static const char *defaultNames[] = {
+	"Lila's Room",
+	"Lila's Cell",
+	"Mother's Secret Office",
+	"Kitchen",
+	"Old Torture Room",
+	"Rooftop Deck",
+	"Master Bedroom",
+	"Dark Closet",
+	"New Torture Room",
+	"Dining Room"
+};
+_Static_assert(sizeof(defaultNames) / sizeof(defaultNames[0]) == CLASSIC_NUM_NAMES,
+               "CLASSIC_NUM_NAMES must count the classic names");
+
+static struct NameList defaultNameList;
+static pthread_once_t defaultNameListOnce = PTHREAD_ONCE_INIT;
+
+// copy the classic names into the default list's arena
+static void buildDefaultNameList(void) {
+	int numNames = sizeof(defaultNames) / sizeof(defaultNames[0]),
+		textSize = 0,
+		i = 0;
+
+	for (i = 0; i < numNames; i++) {
+		textSize += strlen(defaultNames[i]) + 1;
+	}
+	defaultNameList.text = malloc(textSize);
+	defaultNameList.nameOffsets = malloc(sizeof(int) * numNames);
+	defaultNameList.nameLengths = malloc(sizeof(int) * numNames);
+	if (defaultNameList.text == NULL || defaultNameList.nameOffsets == NULL ||
+	    defaultNameList.nameLengths == NULL) {
+		fprintf(stderr, "Could not allocate the default room names.\n");
+		exit(1);
+	}
+	for (i = 0, textSize = 0; i < numNames; i++) {
+		defaultNameList.nameOffsets[i] = textSize;
+		defaultNameList.nameLengths[i] = strlen(defaultNames[i]);
+		memcpy(defaultNameList.text + textSize, defaultNames[i], defaultNameList.nameLengths[i] + 1);
+		textSize += defaultNameList.nameLengths[i] + 1;
+	}
+	defaultNameList.numNames = numNames;
+}
+
+/******************************************************************************
+ * Function Name: getDefaultNameList
+ * Description: Returns the list of the classic game's ten names. It is built
+ *   the first time any thread asks for it and never freed.
+ *****************************************************************************/
+const struct NameList *getDefaultNameList(void) {
+	pthread_once(&defaultNameListOnce, buildDefaultNameList);
+	return &defaultNameList;
+}
+
+/******************************************************************************
+ * Function Name: loadNameList
+ * Description: Read a whole dictionary file, one name per line, and use the
+ *   file's text as the list's arena. Carriage returns before a newline are
+ *   dropped. Blank lines, names longer than MAX_NAME_LENGTH, names holding a
+ *   '#', and repeats of an earlier name are skipped so every name in the
+ *   list is unique. Returns 0 on success or -1 if the file cannot be read
+ *   or holds no usable names.
+ *****************************************************************************/
+int loadNameList(struct NameList *list, const char *fileName) {
+	FILE *fp = fopen(fileName, "r");
+	long length;
+	char *line,
+		 *end;
+	int numLines = 0,
+		size = 16,
+		mask,
+		slot,
+		nameLength,
+		*seen;
+	unsigned int hash;
+
+	memset(list, 0, sizeof(*list));
+	if (fp == NULL) {
+		fprintf(stderr, "Could not open %s to read room names.\n", fileName);
+		return -1;
+	}
+	// read the whole file at once
+	fseek(fp, 0, SEEK_END);
+	length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	list->text = malloc(length + 1);
+	if (list->text == NULL || fread(list->text, 1, length, fp) != (size_t)length) {
+		fprintf(stderr, "Could not read %s.\n", fileName);
+		fclose(fp);
+		freeNameList(list);
+		return -1;
+	}
+	fclose(fp);
+	list->text[length] = '\0';
+
+	// size the offsets and the table of names seen by the number of lines
+	for (line = list->text; (line = memchr(line, '\n', list->text + length - line)) != NULL; line++) {
+		numLines++;
+	}
+	numLines++;
+	while (size < numLines * 2) {
+		size *= 2;
+	}
+	mask = size - 1;
+	list->nameOffsets = malloc(sizeof(int) * numLines);
+	list->nameLengths = malloc(sizeof(int) * numLines);
+	seen = malloc(sizeof(int) * size);
+	if (list->nameOffsets == NULL || list->nameLengths == NULL || seen == NULL) {
+		fprintf(stderr, "Could not allocate %d room names.\n", numLines);
+		exit(1);
+	}
+	memset(seen, -1, sizeof(int) * size);
+
+	// terminate each line and keep it if it is a new, usable name
+	for (line = list->text; line < list->text + length; line = end + 1) {
+		end = memchr(line, '\n', list->text + length - line);
+		if (end == NULL) {
+			end = list->text + length;
+		}
+		*end = '\0';
+		if (end > line && end[-1] == '\r') {
+			end[-1] = '\0';
+		}
+		nameLength = strlen(line);
+		if (nameLength == 0 || nameLength > MAX_NAME_LENGTH || memchr(line, '#', nameLength) != NULL) {
+			continue;
+		}
+		hash = hashRoomName(line, nameLength);
+		for (slot = hash & mask; seen[slot] != -1; slot = (slot + 1) & mask) {
+			int other = seen[slot];
+			if (list->nameLengths[other] == nameLength &&
+			    memcmp(list->text + list->nameOffsets[other], line, nameLength) == 0) {
+				break;
+			}
+		}
+		if (seen[slot] != -1) {
+			continue;
+		}
+		seen[slot] = list->numNames;
+		list->nameOffsets[list->numNames] = line - list->text;
+		list->nameLengths[list->numNames] = nameLength;
+		list->numNames++;
+	}
+	free(seen);
+
+	if (list->numNames == 0) {
+		fprintf(stderr, "%s holds no usable room names.\n", fileName);
+		freeNameList(list);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: freeNameList
+ * Description: Release all memory held by a loaded name list.
+ *****************************************************************************/
+void freeNameList(struct NameList *list) {
+	free(list->text);
+	free(list->nameOffsets);
+	free(list->nameLengths);
+	memset(list, 0, sizeof(*list));
+}
+
+/******************************************************************************
+ * Function Name: initNamePicker
+ * Description: Prepare a picker for up to numPicks names from a list. The
+ *   swap table needs one entry per dictionary name drawn, so it is sized by
+ *   the smaller of numPicks and the list rather than by the whole list. With
+ *   an arena the table comes from it and is released with it.
+ *****************************************************************************/
+void initNamePicker(struct NamePicker *picker, const struct NameList *list, int numPicks,
+                    struct Arena *arena) {
+	int numDrawn = numPicks < list->numNames ? numPicks : list->numNames,
+		size = 16;
+
+	while (size < numDrawn * 2) {
+		size *= 2;
+	}
+	picker->list = list;
+	picker->numPicked = 0;
+	picker->numComposite = 0;
+	picker->mapSize = size;
+	picker->arena = arena;
+	picker->mapKeys = arena != NULL ? allocArena(arena, sizeof(int) * size) : malloc(sizeof(int) * size);
+	picker->mapValues = arena != NULL ? allocArena(arena, sizeof(int) * size) : malloc(sizeof(int) * size);
+	if (picker->mapKeys == NULL || picker->mapValues == NULL) {
+		fprintf(stderr, "Could not allocate a name table of %d slots.\n", size);
+		exit(1);
+	}
+	memset(picker->mapKeys, -1, sizeof(int) * size);
+}
+
+/******************************************************************************
+ * Function Name: freeNamePicker
+ * Description: Release all memory held by a name picker.
+ *****************************************************************************/
+void freeNamePicker(struct NamePicker *picker) {
+	if (picker->arena == NULL) {
+		free(picker->mapKeys);
+		free(picker->mapValues);
+	}
+	picker->mapKeys = NULL;
+	picker->mapValues = NULL;
+}
+
+// slot of a list position in the swap table, or the empty slot it would use
+static int findPickerSlot(const struct NamePicker *picker, int position) {
+	int mask = picker->mapSize - 1,
+		slot = ((unsigned int)position * 2654435761u) & mask;
+
+	while (picker->mapKeys[slot] != -1 && picker->mapKeys[slot] != position) {
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+/******************************************************************************
+ * Function Name: pickName
+ * Description: Copy the next name into a ROOM_NAME_SIZE buffer. Names are
+ *   drawn with a partial Fisher-Yates shuffle: a random position among the
+ *   names not yet drawn is taken, and the last undrawn name moves into it.
+ *   Positions never swapped still hold their own name, so only the swaps
+ *   are stored. After the list runs out, names are the list's names again
+ *   with " #2", " #3", and so on appended.
+ *****************************************************************************/
+void pickName(struct NamePicker *picker, struct Random *random, char *name) {
+	const struct NameList *list = picker->list;
+	int numRemaining = list->numNames - picker->numPicked,
+		position,
+		nameIndex,
+		lastIndex,
+		slot;
+
+	// make a composite name once every listed name has been used
+	if (numRemaining == 0) {
+		nameIndex = picker->numComposite % list->numNames;
+		snprintf(name, ROOM_NAME_SIZE, "%s #%d", list->text + list->nameOffsets[nameIndex],
+		         picker->numComposite / list->numNames + 2);
+		picker->numComposite++;
+		return;
+	}
+
+	// take the name at a random undrawn position
+	position = randomBelow(random, numRemaining);
+	slot = findPickerSlot(picker, position);
+	nameIndex = picker->mapKeys[slot] == -1 ? position : picker->mapValues[slot];
+	// move the last undrawn name into the position just taken
+	lastIndex = findPickerSlot(picker, numRemaining - 1);
+	lastIndex = picker->mapKeys[lastIndex] == -1 ? numRemaining - 1 : picker->mapValues[lastIndex];
+	picker->mapKeys[slot] = position;
+	picker->mapValues[slot] = lastIndex;
+	picker->numPicked++;
+
+	memcpy(name, list->text + list->nameOffsets[nameIndex], list->nameLengths[nameIndex] + 1);
+}
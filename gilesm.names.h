@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.names.h
+ * Description: Room name dictionaries. A name list keeps every name back to
+ *   back in one text arena with an offset and length per name, so a
+ *   dictionary of millions of names is a few large allocations and can be
+ *   shared read-only by every game and thread. Lists are either the built-in
+ *   names of the classic game or loaded from a file with one name per line.
+ *
+ *   A name picker draws names for one world without repeats. It runs a
+ *   partial Fisher-Yates shuffle over the list, keeping only the positions
+ *   it has swapped in a small hash table, so each pick costs O(1) and the
+ *   dictionary is never copied. Once every name has been used the picker
+ *   makes composite names such as "Kitchen #2", which stay unique because
+ *   dictionary names cannot contain '#'.
+ *****************************************************************************/
+#ifndef GILESM_NAMES_H
+#define GILESM_NAMES_H
+
+#include "gilesm.random.h"
+#include "gilesm.arena.h"
+#include "gilesm.config.h"
+
+struct NameList {
+	char *text;							// every name, each terminated
+	int numNames;						// number of names in the list
+	int *nameOffsets;					// start of each name in text
+	int *nameLengths;					// characters in each name
+};
+
+struct NamePicker {
+	const struct NameList *list;		// names to draw from, never changed
+	int numPicked;						// dictionary names drawn so far
+	int numComposite;					// composite names made so far
+	int mapSize;						// slots in the swap table, a power of 2
+	int *mapKeys;						// swapped list position, -1 if empty
+	int *mapValues;						// name now at that position
+	struct Arena *arena;				// arena holding the table, NULL for the heap
+};
+
+// the ten names of the classic game, shared by every caller
+const struct NameList *getDefaultNameList(void);
+// read a dictionary file of names, returns 0 on success or -1
+int loadNameList(struct NameList *list, const char *fileName);
+// release all memory held by a loaded name list
+void freeNameList(struct NameList *list);
+// prepare to draw up to numPicks unique names from a list, using an arena if given
+void initNamePicker(struct NamePicker *picker, const struct NameList *list, int numPicks,
+                    struct Arena *arena);
+// release all memory held by a name picker
+void freeNamePicker(struct NamePicker *picker);
+// copy the next unique random name into a ROOM_NAME_SIZE buffer
+void pickName(struct NamePicker *picker, struct Random *random, char *name);
+
+#endif
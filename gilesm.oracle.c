@@ -0,0 +1,238 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.oracle.c
+ * Description: Shortest path oracle described in gilesm.oracle.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "gilesm.oracle.h"
+
+/******************************************************************************
+ * Function Name: recordGoalDistances
+ * Description: Search breadth first from the end room once and record every
+ *   room's distance to it, -1 for rooms that cannot reach it.
+ *****************************************************************************/
+static void recordGoalDistances(struct PathOracle *oracle) {
+	const struct World *world = oracle->world;
+	int *distance = malloc(sizeof(int) * world->numRooms),
+		*queue = malloc(sizeof(int) * world->numRooms),
+		head = 0,
+		tail = 0,
+		room,
+		i = 0;
+
+	if (distance == NULL || queue == NULL) {
+		fprintf(stderr, "Could not allocate distances for %d rooms.\n", world->numRooms);
+		exit(1);
+	}
+	memset(distance, -1, sizeof(int) * world->numRooms);
+	distance[world->endRoomIndex] = 0;
+	queue[tail++] = world->endRoomIndex;
+	while (head < tail) {
+		const int *conns;
+		room = queue[head++];
+		conns = getConns(world, room);
+		for (i = 0; i < getNumConns(world, room); i++) {
+			if (distance[conns[i]] == -1) {
+				distance[conns[i]] = distance[room] + 1;
+				queue[tail++] = conns[i];
+			}
+		}
+	}
+	free(queue);
+	oracle->goalDistance = distance;
+}
+
+/******************************************************************************
+ * Function Name: initPathOracle
+ * Description: Prepare an oracle for a world that must outlive it. With
+ *   precompute set, every room's distance to the end room is recorded now;
+ *   the arrays used by bidirectional searches are allocated on the first
+ *   search that needs them.
+ *****************************************************************************/
+void initPathOracle(struct PathOracle *oracle, const struct World *world, int precompute) {
+	memset(oracle, 0, sizeof(*oracle));
+	oracle->world = world;
+	if (precompute) {
+		recordGoalDistances(oracle);
+	}
+}
+
+/******************************************************************************
+ * Function Name: freePathOracle
+ * Description: Release all memory held by an oracle.
+ *****************************************************************************/
+void freePathOracle(struct PathOracle *oracle) {
+	free(oracle->goalDistance);
+	free(oracle->forwardSeen);
+	free(oracle->backwardSeen);
+	free(oracle->forwardParent);
+	free(oracle->backwardParent);
+	free(oracle->forwardDistance);
+	free(oracle->backwardDistance);
+	free(oracle->forwardQueue);
+	free(oracle->backwardQueue);
+	memset(oracle, 0, sizeof(*oracle));
+}
+
+// allocate the search arrays, or start over once the search number wraps
+static void startSearch(struct PathOracle *oracle) {
+	int numRooms = oracle->world->numRooms;
+
+	if (oracle->forwardSeen == NULL) {
+		oracle->forwardSeen = calloc(numRooms, sizeof(unsigned int));
+		oracle->backwardSeen = calloc(numRooms, sizeof(unsigned int));
+		oracle->forwardParent = malloc(sizeof(int) * numRooms);
+		oracle->backwardParent = malloc(sizeof(int) * numRooms);
+		oracle->forwardDistance = malloc(sizeof(int) * numRooms);
+		oracle->backwardDistance = malloc(sizeof(int) * numRooms);
+		oracle->forwardQueue = malloc(sizeof(int) * numRooms);
+		oracle->backwardQueue = malloc(sizeof(int) * numRooms);
+		if (oracle->forwardSeen == NULL || oracle->backwardSeen == NULL ||
+		    oracle->forwardParent == NULL || oracle->backwardParent == NULL ||
+		    oracle->forwardDistance == NULL || oracle->backwardDistance == NULL ||
+		    oracle->forwardQueue == NULL || oracle->backwardQueue == NULL) {
+			fprintf(stderr, "Could not allocate a search of %d rooms.\n", numRooms);
+			exit(1);
+		}
+	}
+	if (++oracle->searchNumber == 0) {
+		memset(oracle->forwardSeen, 0, sizeof(unsigned int) * numRooms);
+		memset(oracle->backwardSeen, 0, sizeof(unsigned int) * numRooms);
+		oracle->searchNumber = 1;
+	}
+}
+
+/******************************************************************************
+ * Function Name: searchBothWays
+ * Description: Bidirectional breadth first search between two different
+ *   rooms. Each round widens the smaller frontier by one whole level and
+ *   notes every connection into a room the other side has seen; the round
+ *   that finds one has found the shortest path, through the best of the
+ *   connections it noted. The rooms on either end of that connection are
+ *   kept for findNextRoom. Returns the path's length, or -1 if none exists.
+ *****************************************************************************/
+static int searchBothWays(struct PathOracle *oracle, int fromRoom, int toRoom) {
+	const struct World *world = oracle->world;
+	unsigned int search,
+				 *seen,
+				 *otherSeen;
+	int forwardHead = 0,
+		forwardTail = 0,
+		backwardHead = 0,
+		backwardTail = 0,
+		best = INT_MAX,
+		forward,
+		levelEnd,
+		room,
+		i = 0;
+	int *head,
+		*tail,
+		*queue,
+		*parent,
+		*distance,
+		*otherDistance;
+
+	startSearch(oracle);
+	search = oracle->searchNumber;
+	oracle->forwardSeen[fromRoom] = search;
+	oracle->forwardParent[fromRoom] = -1;
+	oracle->forwardDistance[fromRoom] = 0;
+	oracle->forwardQueue[forwardTail++] = fromRoom;
+	oracle->backwardSeen[toRoom] = search;
+	oracle->backwardParent[toRoom] = -1;
+	oracle->backwardDistance[toRoom] = 0;
+	oracle->backwardQueue[backwardTail++] = toRoom;
+
+	while (best == INT_MAX && forwardHead < forwardTail && backwardHead < backwardTail) {
+		// widen the side with fewer rooms waiting
+		forward = forwardTail - forwardHead <= backwardTail - backwardHead;
+		head = forward ? &forwardHead : &backwardHead;
+		tail = forward ? &forwardTail : &backwardTail;
+		queue = forward ? oracle->forwardQueue : oracle->backwardQueue;
+		seen = forward ? oracle->forwardSeen : oracle->backwardSeen;
+		otherSeen = forward ? oracle->backwardSeen : oracle->forwardSeen;
+		parent = forward ? oracle->forwardParent : oracle->backwardParent;
+		distance = forward ? oracle->forwardDistance : oracle->backwardDistance;
+		otherDistance = forward ? oracle->backwardDistance : oracle->forwardDistance;
+
+		for (levelEnd = *tail; *head < levelEnd; (*head)++) {
+			const int *conns;
+			room = queue[*head];
+			conns = getConns(world, room);
+			for (i = 0; i < getNumConns(world, room); i++) {
+				if (otherSeen[conns[i]] == search) {
+					if (distance[room] + 1 + otherDistance[conns[i]] < best) {
+						best = distance[room] + 1 + otherDistance[conns[i]];
+						oracle->meetForward = forward ? room : conns[i];
+						oracle->meetBackward = forward ? conns[i] : room;
+					}
+				} else if (seen[conns[i]] != search) {
+					seen[conns[i]] = search;
+					parent[conns[i]] = room;
+					distance[conns[i]] = distance[room] + 1;
+					queue[(*tail)++] = conns[i];
+				}
+			}
+		}
+	}
+	return best == INT_MAX ? -1 : best;
+}
+
+/******************************************************************************
+ * Function Name: findPathDistance
+ * Description: Returns the fewest moves from one room to another, or -1 if
+ *   the second cannot be reached from the first. Distances to the end room
+ *   are looked up when the oracle recorded them.
+ *****************************************************************************/
+int findPathDistance(struct PathOracle *oracle, int fromRoom, int toRoom) {
+	if (fromRoom == toRoom) {
+		return 0;
+	}
+	if (oracle->goalDistance != NULL && toRoom == oracle->world->endRoomIndex) {
+		return oracle->goalDistance[fromRoom];
+	}
+	return searchBothWays(oracle, fromRoom, toRoom);
+}
+
+/******************************************************************************
+ * Function Name: findNextRoom
+ * Description: Returns a neighbor of the specified room that lies on a
+ *   shortest path to the end room, or -1 if the room is the end room or
+ *   cannot reach it. With recorded distances this is the first neighbor one
+ *   move closer; otherwise a search is run and the start side of the path
+ *   it found is followed back to its first move.
+ *****************************************************************************/
+int findNextRoom(struct PathOracle *oracle, int fromRoom) {
+	const struct World *world = oracle->world;
+	const int *conns = getConns(world, fromRoom);
+	int room,
+		i = 0;
+
+	if (fromRoom == world->endRoomIndex) {
+		return -1;
+	}
+	if (oracle->goalDistance != NULL) {
+		for (i = 0; i < getNumConns(world, fromRoom); i++) {
+			if (oracle->goalDistance[conns[i]] != -1 &&
+			    oracle->goalDistance[conns[i]] == oracle->goalDistance[fromRoom] - 1) {
+				return conns[i];
+			}
+		}
+		return -1;
+	}
+	if (searchBothWays(oracle, fromRoom, world->endRoomIndex) == -1) {
+		return -1;
+	}
+	// the path leaves the start side through meetForward to meetBackward
+	if (oracle->meetForward == fromRoom) {
+		return oracle->meetBackward;
+	}
+	room = oracle->meetForward;
+	while (oracle->forwardParent[room] != fromRoom) {
+		room = oracle->forwardParent[room];
+	}
+	return room;
+}
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.oracle.h
+ * Description: Shortest path oracle for a world. It answers how many moves
+ *   separate two rooms and which neighbor to move to next to reach the end
+ *   room in as few moves as possible, for hints and for scoring a finished
+ *   game against the best possible route.
+ *
+ *   Without preparation each question is answered by a bidirectional breadth
+ *   first search that grows a frontier from each room, always widening the
+ *   smaller one, and stops as soon as they meet. It visits far fewer rooms
+ *   than a search from one side, and rooms are marked with a search number
+ *   instead of being cleared, so a search costs only what it visits.
+ *
+ *   An oracle can instead spend one search from the end room up front to
+ *   record every room's distance to it. Any room's distance to the end is
+ *   then a lookup and the next move a scan of the room's connections, and
+ *   those questions only read the oracle, so one prepared oracle can serve
+ *   any number of threads. Connections run both ways in every world, so the
+ *   search from the end room follows them as they are stored.
+ *****************************************************************************/
+#ifndef GILESM_ORACLE_H
+#define GILESM_ORACLE_H
+
+#include "gilesm.world.h"
+
+struct PathOracle {
+	const struct World *world;			// world the questions are about
+	int *goalDistance;					// moves from each room to the end, or NULL
+	unsigned int searchNumber;			// marks the rooms seen by the current search
+	unsigned int *forwardSeen;			// search that reached each room from the start side
+	unsigned int *backwardSeen;			// search that reached each room from the goal side
+	int *forwardParent;					// room each room was reached from, start side
+	int *backwardParent;				// room each room was reached from, goal side
+	int *forwardDistance;				// moves from the start side to each room
+	int *backwardDistance;				// moves from each room to the goal side
+	int *forwardQueue;					// rooms to widen from, start side
+	int *backwardQueue;					// rooms to widen from, goal side
+	int meetForward;					// room of the shortest path on the start side
+	int meetBackward;					// next room of the shortest path, goal side
+};
+
+// prepare an oracle, recording every distance to the end room if precompute is set
+void initPathOracle(struct PathOracle *oracle, const struct World *world, int precompute);
+// release all memory held by an oracle
+void freePathOracle(struct PathOracle *oracle);
+// fewest moves from one room to another, or -1 if it cannot be reached
+int findPathDistance(struct PathOracle *oracle, int fromRoom, int toRoom);
+// neighbor to move to next on a shortest path to the end room, or -1 if none
+int findNextRoom(struct PathOracle *oracle, int fromRoom);
+
+#endif
@@ -0,0 +1,129 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.random.c
+ * Description: xoshiro256** random number streams described in
+ *   gilesm.random.h. The generator and its jump polynomial are those
+ *   published by Blackman and Vigna.
+ *****************************************************************************/
+#include <time.h>
+#include <unistd.h>
+#include "gilesm.random.h"
+
+// rotate a 64 bit value left
+static inline uint64_t rotateLeft(uint64_t value, int count) {
+	return (value << count) | (value >> (64 - count));
+}
+
+// advance a splitmix64 state and return its next output
+static uint64_t nextSplitMix(uint64_t *state) {
+	uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/******************************************************************************
+ * Function Name: seedRandom
+ * Description: Seed a stream by expanding a 64 bit seed into the four state
+ *   words with splitmix64, which never yields an all zero state.
+ *****************************************************************************/
+void seedRandom(struct Random *random, uint64_t seed) {
+	int i = 0;
+
+	for (i = 0; i < 4; i++) {
+		random->state[i] = nextSplitMix(&seed);
+	}
+}
+
+/******************************************************************************
+ * Function Name: mixRandomSeed
+ * Description: Returns the seed for the specified index of a family of
+ *   streams. Nearby indices give unrelated seeds, so stream k can be seeded
+ *   directly without stepping through streams 0 to k-1.
+ *****************************************************************************/
+uint64_t mixRandomSeed(uint64_t seed, uint64_t index) {
+	uint64_t state = seed ^ (index * 0xD1B54A32D192ED03ULL);
+
+	return nextSplitMix(&state);
+}
+
+/******************************************************************************
+ * Function Name: nextRandom
+ * Description: Returns the next 64 random bits of the stream.
+ *****************************************************************************/
+uint64_t nextRandom(struct Random *random) {
+	uint64_t *s = random->state;
+	uint64_t result = rotateLeft(s[1] * 5, 7) * 9,
+			 shifted = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= shifted;
+	s[3] = rotateLeft(s[3], 45);
+	return result;
+}
+
+/******************************************************************************
+ * Function Name: randomBelow
+ * Description: Returns a uniform random integer in [0, bound) using Lemire's
+ *   multiply and shift method, rejecting the few products that would bias
+ *   the result. The bound must be positive.
+ *****************************************************************************/
+int randomBelow(struct Random *random, int bound) {
+	uint32_t range = (uint32_t)bound,
+			 threshold;
+	uint64_t product = (nextRandom(random) >> 32) * range;
+
+	if ((uint32_t)product < range) {
+		threshold = -range % range;
+		while ((uint32_t)product < threshold) {
+			product = (nextRandom(random) >> 32) * range;
+		}
+	}
+	return (int)(product >> 32);
+}
+
+/******************************************************************************
+ * Function Name: jumpRandom
+ * Description: Advance the stream by 2^128 numbers. Jumping a copy of a
+ *   stream gives a second stream that will not overlap the first.
+ *****************************************************************************/
+void jumpRandom(struct Random *random) {
+	static const uint64_t jumpPolynomial[4] = {
+		0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+		0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+	};
+	uint64_t jumped[4] = { 0, 0, 0, 0 };
+	int i = 0,
+		bit = 0,
+		j = 0;
+
+	for (i = 0; i < 4; i++) {
+		for (bit = 0; bit < 64; bit++) {
+			if (jumpPolynomial[i] & ((uint64_t)1 << bit)) {
+				for (j = 0; j < 4; j++) {
+					jumped[j] ^= random->state[j];
+				}
+			}
+			nextRandom(random);
+		}
+	}
+	for (j = 0; j < 4; j++) {
+		random->state[j] = jumped[j];
+	}
+}
+
+/******************************************************************************
+ * Function Name: getTimeSeed
+ * Description: Returns a seed that changes between runs, built from the clock
+ *   and the process ID, for games started without --seed.
+ *****************************************************************************/
+uint64_t getTimeSeed(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	return mixRandomSeed((uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec, getpid());
+}
@@ -0,0 +1,36 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.random.h
+ * Description: Seedable random number streams for world generation and
+ *   automated players. Each stream is a xoshiro256** generator owned by its
+ *   caller, so streams never share state between threads and produce the
+ *   same numbers for the same seed on every platform and C library.
+ *
+ *   A stream can be jumped 2^128 numbers ahead to split off a second stream
+ *   that will never overlap the first, and a base seed can be mixed with an
+ *   index to seed any number of independent streams (e.g. one per world of a
+ *   batch) without generating the ones in between.
+ *****************************************************************************/
+#ifndef GILESM_RANDOM_H
+#define GILESM_RANDOM_H
+
+#include <stdint.h>
+
+struct Random {
+	uint64_t state[4];					// xoshiro256** state, never all zero
+};
+
+// seed a stream, expanding the seed with splitmix64
+void seedRandom(struct Random *random, uint64_t seed);
+// seed for the specified index of a family of streams sharing a base seed
+uint64_t mixRandomSeed(uint64_t seed, uint64_t index);
+// next 64 random bits
+uint64_t nextRandom(struct Random *random);
+// uniform random integer from 0 up to but not including bound
+int randomBelow(struct Random *random, int bound);
+// advance the stream by 2^128 numbers
+void jumpRandom(struct Random *random);
+// seed that differs between runs, taken from the clock and process ID
+uint64_t getTimeSeed(void);
+
+#endif
@@ -0,0 +1,319 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.roomcache.c
+ * Description: Room sources and the LRU room cache described in
+ *   gilesm.roomcache.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "gilesm.worldfile.h"
+#include "gilesm.roomcache.h"
+
+struct FileRoomSource {
+	int file_descriptor;				// open binary world file
+	struct WorldFileHeader header;		// header read when the file was opened
+};
+
+/******************************************************************************
+ * Function Name: growRoomRecord
+ * Description: Make sure a record has space for a name of the specified
+ *   length with its terminator and for the specified number of connections.
+ *   Buffers only grow, so a reused record soon stops allocating.
+ *****************************************************************************/
+void growRoomRecord(struct RoomRecord *record, int nameLength, int numConns) {
+	if (nameLength + 1 > record->nameCapacity) {
+		record->nameCapacity = nameLength + 1 > 64 ? nameLength + 1 : 64;
+		record->name = realloc(record->name, record->nameCapacity);
+	}
+	if (numConns > record->connCapacity) {
+		record->connCapacity = numConns > 8 ? numConns : 8;
+		record->conns = realloc(record->conns, sizeof(int) * record->connCapacity);
+	}
+	if (record->name == NULL || (record->connCapacity > 0 && record->conns == NULL)) {
+		fprintf(stderr, "Could not allocate a room record.\n");
+		exit(1);
+	}
+}
+
+// read exactly length bytes at an offset, returns 0 on success or -1
+static int readAt(int file_descriptor, void *buffer, size_t length, uint64_t offset) {
+	ssize_t nread;
+
+	while (length > 0) {
+		nread = pread(file_descriptor, buffer, length, offset);
+		if (nread < 0 && errno == EINTR) {
+			continue;
+		}
+		if (nread <= 0) {
+			return -1;
+		}
+		buffer = (char *)buffer + nread;
+		length -= nread;
+		offset += nread;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: readFileRoom
+ * Description: Decode one room of a binary world file with four reads: its
+ *   room record, its two connection offsets, its connections, and its name.
+ *   Everything read is checked against the header before it is used.
+ *   Returns 0 on success or -1.
+ *****************************************************************************/
+static int readFileRoom(void *data, int roomIndex, struct RoomRecord *record) {
+	struct FileRoomSource *fileSource = data;
+	const struct WorldFileHeader *header = &fileSource->header;
+	struct Room room;
+	int connRange[2],
+		i = 0;
+
+	if (roomIndex < 0 || roomIndex >= header->numRooms ||
+	    readAt(fileSource->file_descriptor, &room, sizeof(room),
+	           header->roomTableOffset + sizeof(room) * (uint64_t)roomIndex) == -1 ||
+	    readAt(fileSource->file_descriptor, connRange, sizeof(connRange),
+	           header->connOffsetsOffset + sizeof(int) * (uint64_t)roomIndex) == -1) {
+		return -1;
+	}
+	if (connRange[0] < 0 || connRange[1] < connRange[0] || connRange[1] > header->numConns ||
+	    room.nameOffset < 0 || room.nameLength < 0 ||
+	    (int64_t)room.nameOffset + room.nameLength >= header->namePoolSize) {
+		return -1;
+	}
+
+	growRoomRecord(record, room.nameLength, connRange[1] - connRange[0]);
+	record->numConns = connRange[1] - connRange[0];
+	if (record->numConns > 0 &&
+	    readAt(fileSource->file_descriptor, record->conns, sizeof(int) * record->numConns,
+	           header->connListOffset + sizeof(int) * (uint64_t)connRange[0]) == -1) {
+		return -1;
+	}
+	for (i = 0; i < record->numConns; i++) {
+		if (record->conns[i] < 0 || record->conns[i] >= header->numRooms) {
+			return -1;
+		}
+	}
+	if (readAt(fileSource->file_descriptor, record->name, room.nameLength,
+	           header->namePoolOffset + room.nameOffset) == -1) {
+		return -1;
+	}
+	record->name[room.nameLength] = '\0';
+	record->nameLength = room.nameLength;
+	record->type = room.type;
+	record->roomIndex = roomIndex;
+	return 0;
+}
+
+// close a world file source
+static void closeFileSource(void *data) {
+	struct FileRoomSource *fileSource = data;
+
+	close(fileSource->file_descriptor);
+	free(fileSource);
+}
+
+/******************************************************************************
+ * Function Name: openFileRoomSource
+ * Description: Open a binary world file as a room source. Only the header is
+ *   read now; rooms are read when the cache asks for them. Returns 0 on
+ *   success or -1 if the file cannot be used.
+ *****************************************************************************/
+int openFileRoomSource(struct RoomSource *source, const char *fileName) {
+	struct FileRoomSource *fileSource = malloc(sizeof(struct FileRoomSource));
+	struct stat fileInfo;
+
+	if (fileSource == NULL) {
+		fprintf(stderr, "Could not allocate a room source.\n");
+		return -1;
+	}
+	fileSource->file_descriptor = open(fileName, O_RDONLY);
+	if (fileSource->file_descriptor == -1) {
+		fprintf(stderr, "Could not open %s to read the world.\n", fileName);
+		free(fileSource);
+		return -1;
+	}
+	if (fstat(fileSource->file_descriptor, &fileInfo) == -1 ||
+	    readAt(fileSource->file_descriptor, &fileSource->header, sizeof(fileSource->header), 0) == -1) {
+		fprintf(stderr, "%s is too short to be a world file.\n", fileName);
+		closeFileSource(fileSource);
+		return -1;
+	}
+	if (checkWorldHeader(&fileSource->header, fileInfo.st_size, fileName) == -1) {
+		closeFileSource(fileSource);
+		return -1;
+	}
+
+	source->numRooms = fileSource->header.numRooms;
+	source->startRoomIndex = fileSource->header.startRoomIndex;
+	source->endRoomIndex = fileSource->header.endRoomIndex;
+	source->data = fileSource;
+	source->readRoom = readFileRoom;
+	source->closeSource = closeFileSource;
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: closeRoomSource
+ * Description: Release a room source.
+ *****************************************************************************/
+void closeRoomSource(struct RoomSource *source) {
+	if (source->closeSource != NULL) {
+		source->closeSource(source->data);
+	}
+	source->data = NULL;
+}
+
+/******************************************************************************
+ * Function Name: initRoomCache
+ * Description: Prepare an empty cache of at most capacity rooms. Slots and
+ *   hash buckets are allocated once; the rooms' own buffers are allocated as
+ *   slots are first filled and then reused.
+ *****************************************************************************/
+void initRoomCache(struct RoomCache *cache, struct RoomSource *source, int capacity) {
+	int numBuckets = 16;
+
+	if (capacity < 1) {
+		capacity = 1;
+	}
+	while (numBuckets < capacity * 2) {
+		numBuckets *= 2;
+	}
+	memset(cache, 0, sizeof(*cache));
+	cache->source = source;
+	cache->capacity = capacity;
+	cache->slots = calloc(capacity, sizeof(struct RoomCacheSlot));
+	cache->buckets = malloc(sizeof(int) * numBuckets);
+	if (cache->slots == NULL || cache->buckets == NULL) {
+		fprintf(stderr, "Could not allocate a cache of %d rooms.\n", capacity);
+		exit(1);
+	}
+	memset(cache->buckets, -1, sizeof(int) * numBuckets);
+	cache->bucketMask = numBuckets - 1;
+	cache->newest = -1;
+	cache->oldest = -1;
+}
+
+/******************************************************************************
+ * Function Name: freeRoomCache
+ * Description: Release all memory held by a cache. The source stays open.
+ *****************************************************************************/
+void freeRoomCache(struct RoomCache *cache) {
+	int i = 0;
+
+	for (i = 0; i < cache->numSlots; i++) {
+		free(cache->slots[i].record.name);
+		free(cache->slots[i].record.conns);
+	}
+	free(cache->slots);
+	free(cache->buckets);
+	cache->slots = NULL;
+	cache->buckets = NULL;
+}
+
+// bucket of a room index
+static int findRoomBucket(const struct RoomCache *cache, int roomIndex) {
+	return ((unsigned int)roomIndex * 2654435761u) & cache->bucketMask;
+}
+
+// take a slot out of the recency list
+static void unlinkRoomSlot(struct RoomCache *cache, int slot) {
+	struct RoomCacheSlot *entry = &cache->slots[slot];
+
+	if (entry->newer != -1) {
+		cache->slots[entry->newer].older = entry->older;
+	} else {
+		cache->newest = entry->older;
+	}
+	if (entry->older != -1) {
+		cache->slots[entry->older].newer = entry->newer;
+	} else {
+		cache->oldest = entry->newer;
+	}
+}
+
+// put a slot at the most recently used end of the recency list
+static void pushRoomSlot(struct RoomCache *cache, int slot) {
+	struct RoomCacheSlot *entry = &cache->slots[slot];
+
+	entry->newer = -1;
+	entry->older = cache->newest;
+	if (cache->newest != -1) {
+		cache->slots[cache->newest].newer = slot;
+	} else {
+		cache->oldest = slot;
+	}
+	cache->newest = slot;
+}
+
+// take a slot out of its hash bucket's chain
+static void unchainRoomSlot(struct RoomCache *cache, int slot) {
+	int *link = &cache->buckets[findRoomBucket(cache, cache->slots[slot].record.roomIndex)];
+
+	while (*link != slot) {
+		link = &cache->slots[*link].chainNext;
+	}
+	*link = cache->slots[slot].chainNext;
+}
+
+/******************************************************************************
+ * Function Name: getCachedRoom
+ * Description: Returns the decoded room with the specified index. A cached
+ *   room is moved to the most recently used end and returned; otherwise the
+ *   room is read from the source into a free slot, or into the slot of the
+ *   least recently used room once the cache is full. The record stays valid
+ *   until the next request that misses. Returns NULL if the source cannot
+ *   read the room.
+ *****************************************************************************/
+const struct RoomRecord *getCachedRoom(struct RoomCache *cache, int roomIndex) {
+	int bucket = findRoomBucket(cache, roomIndex),
+		slot;
+
+	// answer from the cache when the room is there
+	for (slot = cache->buckets[bucket]; slot != -1; slot = cache->slots[slot].chainNext) {
+		if (cache->slots[slot].record.roomIndex == roomIndex) {
+			cache->numHits++;
+			if (cache->newest != slot) {
+				unlinkRoomSlot(cache, slot);
+				pushRoomSlot(cache, slot);
+			}
+			return &cache->slots[slot].record;
+		}
+	}
+
+	// otherwise take a free slot, or the least recently used one
+	cache->numMisses++;
+	if (cache->numSlots < cache->capacity) {
+		slot = cache->numSlots++;
+	} else {
+		slot = cache->oldest;
+		unlinkRoomSlot(cache, slot);
+		if (cache->slots[slot].record.roomIndex != -1) {
+			unchainRoomSlot(cache, slot);
+			cache->numEvictions++;
+		}
+	}
+	if (cache->source->readRoom(cache->source->data, roomIndex, &cache->slots[slot].record) == -1) {
+		// keep the slot, empty, as the next one to be reused
+		cache->slots[slot].record.roomIndex = -1;
+		cache->slots[slot].chainNext = -1;
+		cache->slots[slot].newer = cache->oldest;
+		cache->slots[slot].older = -1;
+		if (cache->oldest != -1) {
+			cache->slots[cache->oldest].older = slot;
+		} else {
+			cache->newest = slot;
+		}
+		cache->oldest = slot;
+		return NULL;
+	}
+	cache->slots[slot].chainNext = cache->buckets[bucket];
+	cache->buckets[bucket] = slot;
+	pushRoomSlot(cache, slot);
+	return &cache->slots[slot].record;
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.roomcache.h
+ * Description: Lazy room loading for worlds too large to hold in memory. A
+ *   room source decodes one room at a time on request, and a room cache
+ *   keeps a fixed number of decoded rooms, evicting the least recently used
+ *   one when it needs space. A game played through the cache touches only
+ *   the rooms the player enters and their neighbors, so its memory stays
+ *   the same however many rooms the world has.
+ *
+ *   The world file source reads a room's record, connections, and name with
+ *   pread straight from a binary world file, so nothing but the header is
+ *   read up front and nothing is mapped. Other sources only need to supply
+ *   a readRoom function.
+ *
+ *   The cache counts hits, misses, and evictions so it can be sized for the
+ *   way a world is played.
+ *****************************************************************************/
+#ifndef GILESM_ROOMCACHE_H
+#define GILESM_ROOMCACHE_H
+
+#define ROOM_CACHE_SIZE 1024			// rooms cached unless told otherwise
+
+struct RoomRecord {
+	int roomIndex;						// room this record holds, -1 if none
+	int type;							// START_ROOM, END_ROOM, MID_ROOM
+	int nameLength;						// characters in name
+	int numConns;						// number of connected rooms
+	char *name;							// room name, terminated
+	int *conns;							// room indices of connected rooms
+	int nameCapacity;					// bytes name has space for
+	int connCapacity;					// entries conns has space for
+};
+
+struct RoomSource {
+	int numRooms;						// number of rooms in the world
+	int startRoomIndex;					// room the player starts in
+	int endRoomIndex;					// room the player must reach
+	void *data;							// state of the source
+	// decode a room into a record, returns 0 on success or -1
+	int (*readRoom)(void *data, int roomIndex, struct RoomRecord *record);
+	// release the state of the source
+	void (*closeSource)(void *data);
+};
+
+struct RoomCacheSlot {
+	struct RoomRecord record;			// decoded room
+	int newer;							// slot used more recently, or -1
+	int older;							// slot used less recently, or -1
+	int chainNext;						// next slot in the same bucket, or -1
+};
+
+struct RoomCache {
+	struct RoomSource *source;			// where missing rooms are read from
+	int capacity;						// most rooms held at once
+	int numSlots;						// slots holding a room
+	struct RoomCacheSlot *slots;		// decoded rooms
+	int *buckets;						// first slot of each hash bucket, or -1
+	int bucketMask;						// buckets minus one, a power of 2 less one
+	int newest;							// most recently used slot, or -1
+	int oldest;							// least recently used slot, or -1
+	long numHits;						// requests answered from the cache
+	long numMisses;						// requests read from the source
+	long numEvictions;					// rooms dropped to make space
+};
+
+// make sure a record can hold a name and connections of the specified sizes
+void growRoomRecord(struct RoomRecord *record, int nameLength, int numConns);
+// open a binary world file as a room source, returns 0 on success or -1
+int openFileRoomSource(struct RoomSource *source, const char *fileName);
+// release a room source
+void closeRoomSource(struct RoomSource *source);
+// prepare a cache of at most capacity rooms read from a source
+void initRoomCache(struct RoomCache *cache, struct RoomSource *source, int capacity);
+// release all memory held by a cache
+void freeRoomCache(struct RoomCache *cache);
+// decoded room, valid until the next miss, or NULL if it cannot be read
+const struct RoomRecord *getCachedRoom(struct RoomCache *cache, int roomIndex);
+
+#endif
@@ -0,0 +1,218 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.roommatrix.c
+ * Description: Bit packed adjacency matrix described in gilesm.roommatrix.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gilesm.roommatrix.h"
+#include "gilesm.world.h"
+
+// words per row for a world of the specified size, 0 if it is too large
+static int getRowWords(int numRooms) {
+	if (numRooms <= 64) {
+		return 1;
+	}
+	if (numRooms <= 256) {
+		return 4;
+	}
+	return numRooms <= ROOM_MATRIX_MAX_ROOMS ? ROOM_MATRIX_MAX_WORDS : 0;
+}
+
+// first word of a room's row
+static const uint64_t *getMatrixRow(const struct RoomMatrix *matrix, int roomIndex) {
+	return matrix->rows + (size_t)roomIndex * matrix->numWords;
+}
+
+/******************************************************************************
+ * Function Name: getRoomMatrixSize
+ * Description: Returns the bytes of rows a matrix for the specified number
+ *   of rooms takes, or 0 if a world that large gets no matrix.
+ *****************************************************************************/
+size_t getRoomMatrixSize(int numRooms) {
+	return sizeof(uint64_t) * (size_t)numRooms * getRowWords(numRooms);
+}
+
+/******************************************************************************
+ * Function Name: initRoomMatrix
+ * Description: Allocate a matrix with no connections for the specified
+ *   number of rooms, from an arena if one is given. Returns 0, or -1 with
+ *   rows left NULL if the world has more than ROOM_MATRIX_MAX_ROOMS rooms.
+ *****************************************************************************/
+int initRoomMatrix(struct RoomMatrix *matrix, int numRooms, struct Arena *arena) {
+	matrix->numRooms = numRooms;
+	matrix->numWords = getRowWords(numRooms);
+	matrix->arena = arena;
+	matrix->rows = NULL;
+	if (matrix->numWords == 0 || numRooms < 1) {
+		return -1;
+	}
+	matrix->rows = arena != NULL ? allocArena(arena, getRoomMatrixSize(numRooms)) :
+	               malloc(getRoomMatrixSize(numRooms));
+	if (matrix->rows == NULL) {
+		fprintf(stderr, "Could not allocate a matrix of %d rooms.\n", numRooms);
+		exit(1);
+	}
+	clearRoomMatrix(matrix);
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: freeRoomMatrix
+ * Description: Release the rows of a matrix.
+ *****************************************************************************/
+void freeRoomMatrix(struct RoomMatrix *matrix) {
+	if (matrix->arena == NULL) {
+		free(matrix->rows);
+	}
+	matrix->rows = NULL;
+}
+
+/******************************************************************************
+ * Function Name: clearRoomMatrix
+ * Description: Remove every connection from a matrix.
+ *****************************************************************************/
+void clearRoomMatrix(struct RoomMatrix *matrix) {
+	memset(matrix->rows, 0, getRoomMatrixSize(matrix->numRooms));
+}
+
+/******************************************************************************
+ * Function Name: fillRoomMatrix
+ * Description: Replace a matrix's connections with those of a world that has
+ *   as many rooms as the matrix.
+ *****************************************************************************/
+void fillRoomMatrix(struct RoomMatrix *matrix, const struct World *world) {
+	int i = 0,
+		j = 0;
+
+	clearRoomMatrix(matrix);
+	for (i = 0; i < world->numRooms; i++) {
+		const int *conns = getConns(world, i);
+		for (j = 0; j < getNumConns(world, i); j++) {
+			setMatrixConn(matrix, i, conns[j]);
+		}
+	}
+}
+
+/******************************************************************************
+ * Function Name: countMatrixConns
+ * Description: Returns the number of rooms a room connects to, counted with
+ *   one population count per word of its row.
+ *****************************************************************************/
+int countMatrixConns(const struct RoomMatrix *matrix, int roomIndex) {
+	const uint64_t *row = getMatrixRow(matrix, roomIndex);
+	int count = 0,
+		word = 0;
+
+	for (word = 0; word < matrix->numWords; word++) {
+		count += __builtin_popcountll(row[word]);
+	}
+	return count;
+}
+
+// load a 64 by 64 block of bits: the rows from the block's first room, one
+// word of each, with rows past the last room empty
+static void loadMatrixBlock(const struct RoomMatrix *matrix, int firstRoom, int word, uint64_t *block) {
+	int i = 0;
+
+	for (i = 0; i < 64; i++) {
+		block[i] = firstRoom + i < matrix->numRooms ? getMatrixRow(matrix, firstRoom + i)[word] : 0;
+	}
+}
+
+// transpose a 64 by 64 block of bits in place, swapping ever smaller
+// quarters: 32 by 32 corners, then 16 by 16 within them, down to single bits
+static void transposeMatrixBlock(uint64_t *block) {
+	uint64_t mask = 0x00000000FFFFFFFFULL,
+			 swap;
+	int width = 32,
+		i = 0;
+
+	for (; width != 0; width >>= 1, mask ^= mask << width) {
+		for (i = 0; i < 64; i = (i + width + 1) & ~width) {
+			swap = ((block[i] >> width) ^ block[i + width]) & mask;
+			block[i] ^= swap << width;
+			block[i + width] ^= swap;
+		}
+	}
+}
+
+/******************************************************************************
+ * Function Name: isMatrixSymmetric
+ * Description: Returns 1 if every room a room connects to connects back to
+ *   it, otherwise 0. The matrix is split into 64 by 64 blocks of bits, and
+ *   it is symmetric when each block equals the transpose of its mirror
+ *   block across the diagonal, so each pair of blocks is compared a word
+ *   at a time after one transpose.
+ *****************************************************************************/
+int isMatrixSymmetric(const struct RoomMatrix *matrix) {
+	uint64_t block[64],
+			 mirror[64],
+			 differ = 0;
+	int blockRow = 0,
+		blockColumn = 0,
+		i = 0;
+
+	for (blockRow = 0; blockRow < matrix->numWords; blockRow++) {
+		for (blockColumn = blockRow; blockColumn < matrix->numWords; blockColumn++) {
+			loadMatrixBlock(matrix, blockRow * 64, blockColumn, block);
+			loadMatrixBlock(matrix, blockColumn * 64, blockRow, mirror);
+			transposeMatrixBlock(mirror);
+			for (i = 0; i < 64; i++) {
+				differ |= block[i] ^ mirror[i];
+			}
+			if (differ != 0) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+/******************************************************************************
+ * Function Name: countMatrixReachable
+ * Description: Returns the number of rooms reachable from a room, itself
+ *   included. Each level of a breadth first search or-s together the rows
+ *   of the rooms on the frontier, and the new frontier is what that reaches
+ *   that was not reached before, so no queue or visited array is needed and
+ *   nothing is allocated.
+ *****************************************************************************/
+int countMatrixReachable(const struct RoomMatrix *matrix, int startRoom) {
+	uint64_t reached[ROOM_MATRIX_MAX_WORDS] = { 0 },
+			 frontier[ROOM_MATRIX_MAX_WORDS] = { 0 },
+			 next[ROOM_MATRIX_MAX_WORDS],
+			 bits,
+			 growing;
+	const uint64_t *row;
+	int numWords = matrix->numWords,
+		count = 0,
+		word = 0,
+		i = 0;
+
+	reached[startRoom >> 6] = frontier[startRoom >> 6] = (uint64_t)1 << (startRoom & 63);
+	do {
+		// every room one connection past the frontier
+		memset(next, 0, sizeof(next));
+		for (word = 0; word < numWords; word++) {
+			for (bits = frontier[word]; bits != 0; bits &= bits - 1) {
+				row = getMatrixRow(matrix, word * 64 + __builtin_ctzll(bits));
+				for (i = 0; i < numWords; i++) {
+					next[i] |= row[i];
+				}
+			}
+		}
+		// keep only rooms not reached before
+		growing = 0;
+		for (i = 0; i < numWords; i++) {
+			frontier[i] = next[i] & ~reached[i];
+			reached[i] |= frontier[i];
+			growing |= frontier[i];
+		}
+	} while (growing != 0);
+
+	for (i = 0; i < numWords; i++) {
+		count += __builtin_popcountll(reached[i]);
+	}
+	return count;
+}
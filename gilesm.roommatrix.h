@@ -0,0 +1,71 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.roommatrix.h
+ * Description: Bit packed adjacency matrix for small worlds. Each room has a
+ *   row of bits, one per room, set where it connects: one 64 bit word per
+ *   row for up to 64 rooms, four for up to 256, and eight for up to 512.
+ *   Larger worlds do not get a matrix; the connection lists of gilesm.world.h
+ *   serve them instead.
+ *
+ *   A connection test is one bit test and a room's degree a population
+ *   count. Checks over the whole graph work a word at a time: reachability
+ *   is a breadth first search whose frontier and visited rooms are bitsets,
+ *   widened a level at a time by or-ing together the rows of the frontier,
+ *   and symmetry compares each 64 by 64 block of bits with the transpose of
+ *   its mirror block. Rows are at most 64 bytes, so the word loops are short
+ *   and fixed in width, and the compiler turns them into vector
+ *   instructions where the target has them.
+ *****************************************************************************/
+#ifndef GILESM_ROOMMATRIX_H
+#define GILESM_ROOMMATRIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gilesm.arena.h"
+
+#define ROOM_MATRIX_MAX_ROOMS 512			// largest world given a matrix
+#define ROOM_MATRIX_MAX_WORDS (ROOM_MATRIX_MAX_ROOMS / 64)
+
+struct World;
+
+struct RoomMatrix {
+	int numRooms;						// rows, and bits used in each row
+	int numWords;						// 64 bit words per row: 1, 4, or 8
+	uint64_t *rows;						// numRooms rows, NULL without a matrix
+	struct Arena *arena;				// arena holding the rows, NULL for the heap
+};
+
+// bytes of rows a matrix of the specified size needs, 0 if it is too large
+size_t getRoomMatrixSize(int numRooms);
+// allocate an empty matrix, from an arena or, if it is NULL, the heap;
+// returns 0, or -1 with no rows if the world is too large for one
+int initRoomMatrix(struct RoomMatrix *matrix, int numRooms, struct Arena *arena);
+// release the rows of a matrix
+void freeRoomMatrix(struct RoomMatrix *matrix);
+// remove every connection from a matrix
+void clearRoomMatrix(struct RoomMatrix *matrix);
+// set the bits of every connection in a world of the matrix's size
+void fillRoomMatrix(struct RoomMatrix *matrix, const struct World *world);
+// number of rooms the specified room connects to
+int countMatrixConns(const struct RoomMatrix *matrix, int roomIndex);
+// returns 1 if every connection has one leading back, otherwise 0
+int isMatrixSymmetric(const struct RoomMatrix *matrix);
+// number of rooms reachable from the specified room, itself included
+int countMatrixReachable(const struct RoomMatrix *matrix, int startRoom);
+
+// returns 1 if the first room's row has the second room's bit set
+static inline int hasMatrixConn(const struct RoomMatrix *matrix, int fromRoom, int toRoom) {
+	return (matrix->rows[(size_t)fromRoom * matrix->numWords + (toRoom >> 6)] >> (toRoom & 63)) & 1;
+}
+
+// set the second room's bit in the first room's row
+static inline void setMatrixConn(struct RoomMatrix *matrix, int fromRoom, int toRoom) {
+	matrix->rows[(size_t)fromRoom * matrix->numWords + (toRoom >> 6)] |= (uint64_t)1 << (toRoom & 63);
+}
+
+// clear the second room's bit in the first room's row
+static inline void clearMatrixConn(struct RoomMatrix *matrix, int fromRoom, int toRoom) {
+	matrix->rows[(size_t)fromRoom * matrix->numWords + (toRoom >> 6)] &= ~((uint64_t)1 << (toRoom & 63));
+}
+
+#endif
@@ -0,0 +1,458 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.server.c
+ * Description: Unix domain socket game server described in gilesm.server.h.
+ *****************************************************************************/
+#define _GNU_SOURCE					// accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/resource.h>
+#include "gilesm.adventure.h"
+#include "gilesm.server.h"
+
+#define SERVER_EVENTS 64				// events taken from epoll at once
+#define SERVER_READS 16					// reads per session before others run
+#define SERVER_READ_SIZE 4096			// bytes taken from a session per read
+
+struct Session {
+	int socket;							// connection to the player
+	int currentRoom;					// room the player is in
+	int stepCount;						// number of steps taken
+	int stepCapacity;					// rooms stepList has space for
+	int *stepList;						// room index of every step, in order
+	int lineLength;						// characters of the partial input line
+	int lineOverflow;					// partial line is longer than any name
+	int closing;						// close once all output has been sent
+	char *pending;						// output the socket would not yet take
+	size_t pendingLength;				// bytes of pending not yet sent
+	size_t pendingOffset;				// bytes of pending already sent
+	char line[SESSION_LINE_SIZE];		// partial input line
+};
+
+struct Output {
+	char *text;							// output gathered for one session
+	size_t length;						// bytes gathered
+	size_t capacity;					// bytes text has space for
+};
+
+struct Server {
+	const struct World *world;			// world every session plays, never changed
+	struct PathOracle oracle;			// distances to the end room, never changed
+	int epoll;							// event loop shared by all workers
+	int listener;						// socket accepting new players
+	int signals;						// signalfd for SIGINT and SIGTERM
+	long numActive;						// sessions open now
+	long numSessions;					// sessions accepted so far
+	long numWon;						// sessions that reached the end room
+	long numMoves;						// moves made in all sessions
+};
+
+// make room for more bytes in a worker's output
+static void growOutput(struct Output *output, size_t length) {
+	size_t capacity = output->capacity > 0 ? output->capacity : 4096;
+
+	if (output->length + length <= output->capacity) {
+		return;
+	}
+	while (output->length + length > capacity) {
+		capacity *= 2;
+	}
+	output->text = realloc(output->text, capacity);
+	if (output->text == NULL) {
+		fprintf(stderr, "Could not allocate %zu bytes of output.\n", capacity);
+		exit(1);
+	}
+	output->capacity = capacity;
+}
+
+// add text to a worker's output
+static void appendOutput(struct Output *output, const char *text, size_t length) {
+	growOutput(output, length);
+	memcpy(output->text + output->length, text, length);
+	output->length += length;
+}
+
+// add a room's prompt to a worker's output, rendering it again if it did not fit
+static void appendPrompt(struct Output *output, const struct World *world, int roomIndex) {
+	size_t length = formatRoomPrompt(world, roomIndex, output->text + output->length,
+	                                 output->capacity - output->length);
+
+	if (output->length + length > output->capacity) {
+		growOutput(output, length);
+		formatRoomPrompt(world, roomIndex, output->text + output->length, length);
+	}
+	output->length += length;
+}
+
+// record a move in a session's step list
+static void addSessionStep(struct Session *session, int roomIndex) {
+	if (session->stepCount == session->stepCapacity) {
+		int capacity = session->stepCapacity > 0 ? session->stepCapacity * 2 : 16;
+		int *stepList = realloc(session->stepList, sizeof(int) * capacity);
+		if (stepList == NULL) {
+			fprintf(stderr, "Could not allocate %d steps.\n", capacity);
+			exit(1);
+		}
+		session->stepList = stepList;
+		session->stepCapacity = capacity;
+	}
+	session->stepList[session->stepCount++] = roomIndex;
+}
+
+/******************************************************************************
+ * Function Name: playSessionLine
+ * Description: Play one line typed by a player, exactly as playGame would:
+ *   move if it names a connected room, give a hint if asked, complain
+ *   otherwise, and follow with the next prompt, or with the results once the
+ *   end room is reached. Hints and scores come from the server's prepared
+ *   oracle, which every worker reads without locking.
+ *****************************************************************************/
+static void playSessionLine(struct Server *server, struct Session *session, struct Output *output) {
+	const struct World *world = server->world;
+	int roomIndex = -1;
+	size_t length;
+	char *report;
+
+	if (session->lineLength > 0 && session->line[session->lineLength - 1] == '\r') {
+		session->lineLength--;
+	}
+	if (!session->lineOverflow) {
+		roomIndex = findRoom(world, session->line, session->lineLength);
+	}
+	appendOutput(output, "\n", 1);
+	if (roomIndex != -1 && isConnected(world, session->currentRoom, roomIndex)) {
+		session->currentRoom = roomIndex;
+		addSessionStep(session, roomIndex);
+		__atomic_fetch_add(&server->numMoves, 1, __ATOMIC_RELAXED);
+		if (roomIndex == world->endRoomIndex) {
+			report = formatGameResults(world, session->stepList, session->stepCount,
+			                           findPathDistance(&server->oracle, world->startRoomIndex,
+			                                            world->endRoomIndex), &length);
+			appendOutput(output, report, length);
+			free(report);
+			__atomic_fetch_add(&server->numWon, 1, __ATOMIC_RELAXED);
+			session->closing = 1;
+			return;
+		}
+	} else if (session->lineLength == 4 && memcmp(session->line, "hint", 4) == 0 &&
+	           (roomIndex = findNextRoom(&server->oracle, session->currentRoom)) != -1) {
+		appendOutput(output, "HINT: TRY ", 10);
+		appendOutput(output, getRoomName(world, roomIndex), world->roomList[roomIndex].nameLength);
+		appendOutput(output, ".\n\n", 3);
+	} else {
+		appendOutput(output, "HUH? I DON'T UNDERSTAND THAT ROOM. TRY AGAIN.\n\n", 47);
+	}
+	appendPrompt(output, world, session->currentRoom);
+}
+
+// split input into lines and play each one until the game is over
+static void playSessionInput(struct Server *server, struct Session *session, struct Output *output,
+                             const char *input, size_t length) {
+	size_t i = 0;
+
+	for (i = 0; i < length && !session->closing; i++) {
+		if (input[i] == '\n') {
+			playSessionLine(server, session, output);
+			session->lineLength = 0;
+			session->lineOverflow = 0;
+		} else if (session->lineLength < SESSION_LINE_SIZE) {
+			session->line[session->lineLength++] = input[i];
+		} else {
+			session->lineOverflow = 1;
+		}
+	}
+}
+
+/******************************************************************************
+ * Function Name: sendSession
+ * Description: Send a session's pending output followed by new output, with
+ *   one send call unless the socket fills up. Whatever the socket will not
+ *   take is kept as the session's pending output. Returns 0, or -1 if the
+ *   connection has failed.
+ *****************************************************************************/
+static int sendSession(struct Session *session, const char *text, size_t length) {
+	ssize_t nsent;
+
+	// finish the earlier output first so the player sees it in order
+	while (session->pendingLength > 0) {
+		nsent = send(session->socket, session->pending + session->pendingOffset,
+		             session->pendingLength, MSG_NOSIGNAL);
+		if (nsent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				return -1;
+			}
+			break;
+		}
+		session->pendingOffset += nsent;
+		session->pendingLength -= nsent;
+	}
+	while (session->pendingLength == 0 && length > 0) {
+		nsent = send(session->socket, text, length, MSG_NOSIGNAL);
+		if (nsent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				return -1;
+			}
+			break;
+		}
+		text += nsent;
+		length -= nsent;
+	}
+	if (length == 0) {
+		if (session->pendingLength == 0) {
+			free(session->pending);
+			session->pending = NULL;
+			session->pendingOffset = 0;
+		}
+		return 0;
+	}
+
+	// keep what is left, after anything still pending
+	{
+		char *pending = malloc(session->pendingLength + length);
+		if (pending == NULL) {
+			return -1;
+		}
+		memcpy(pending, session->pending + session->pendingOffset, session->pendingLength);
+		memcpy(pending + session->pendingLength, text, length);
+		free(session->pending);
+		session->pending = pending;
+		session->pendingOffset = 0;
+		session->pendingLength += length;
+	}
+	return 0;
+}
+
+// close a session's connection and release it
+static void closeSession(struct Server *server, struct Session *session) {
+	close(session->socket);
+	free(session->stepList);
+	free(session->pending);
+	free(session);
+	__atomic_fetch_sub(&server->numActive, 1, __ATOMIC_RELAXED);
+}
+
+// hand a session back to the event loop, waiting to read or to write
+static void watchSession(struct Server *server, struct Session *session, int operation) {
+	struct epoll_event event;
+
+	event.events = (session->pendingLength > 0 ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+	event.data.ptr = session;
+	if (epoll_ctl(server->epoll, operation, session->socket, &event) == -1) {
+		closeSession(server, session);
+	}
+}
+
+/******************************************************************************
+ * Function Name: serveSession
+ * Description: Serve a session the event loop found ready. Available input
+ *   is read and played, and all the output it causes is sent together. The
+ *   session then goes back to the event loop, or is closed once the game is
+ *   over and its output has been sent.
+ *****************************************************************************/
+static void serveSession(struct Server *server, struct Session *session, struct Output *output) {
+	char input[SERVER_READ_SIZE];
+	ssize_t nread = 0;
+	int i = 0;
+
+	output->length = 0;
+	if (session->pendingLength == 0) {
+		for (i = 0; i < SERVER_READS && !session->closing; i++) {
+			nread = recv(session->socket, input, sizeof(input), 0);
+			if (nread > 0) {
+				playSessionInput(server, session, output, input, nread);
+			} else if (nread == 0) {
+				// the player will type nothing more
+				session->closing = 1;
+			} else if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			} else {
+				closeSession(server, session);
+				return;
+			}
+		}
+	}
+	if (sendSession(session, output->text, output->length) == -1 ||
+	    (session->closing && session->pendingLength == 0)) {
+		closeSession(server, session);
+		return;
+	}
+	watchSession(server, session, EPOLL_CTL_MOD);
+}
+
+// accept every waiting player and send each the first prompt
+static void acceptSessions(struct Server *server, struct Output *output) {
+	struct Session *session;
+	int socket;
+
+	while ((socket = accept4(server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+		session = calloc(1, sizeof(struct Session));
+		if (session == NULL) {
+			close(socket);
+			continue;
+		}
+		session->socket = socket;
+		session->currentRoom = server->world->startRoomIndex;
+		__atomic_fetch_add(&server->numActive, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&server->numSessions, 1, __ATOMIC_RELAXED);
+
+		output->length = 0;
+		appendPrompt(output, server->world, session->currentRoom);
+		if (sendSession(session, output->text, output->length) == -1) {
+			closeSession(server, session);
+			continue;
+		}
+		watchSession(server, session, EPOLL_CTL_ADD);
+	}
+	if (errno == EMFILE || errno == ENFILE) {
+		fprintf(stderr, "Out of file descriptors, %ld sessions open.\n", server->numActive);
+	}
+}
+
+/******************************************************************************
+ * Function Name: serverThread
+ * Description: Worker thread body. Runs the shared event loop until SIGINT
+ *   or SIGTERM arrives. The signal is never read, so it stays pending and
+ *   wakes every worker.
+ *****************************************************************************/
+static void *serverThread(void *arg) {
+	struct Server *server = arg;
+	struct epoll_event events[SERVER_EVENTS];
+	struct Output output = { NULL, 0, 0 };
+	int numEvents,
+		stop = 0,
+		i = 0;
+
+	while (!stop) {
+		numEvents = epoll_wait(server->epoll, events, SERVER_EVENTS, -1);
+		if (numEvents == -1 && errno != EINTR) {
+			fprintf(stderr, "Could not wait for events: %s\n", strerror(errno));
+			break;
+		}
+		for (i = 0; i < numEvents; i++) {
+			if (events[i].data.ptr == &server->signals) {
+				stop = 1;
+			} else if (events[i].data.ptr == &server->listener) {
+				acceptSessions(server, &output);
+			} else {
+				serveSession(server, events[i].data.ptr, &output);
+			}
+		}
+	}
+	free(output.text);
+	return NULL;
+}
+
+// add a file descriptor that every worker watches to the event loop
+static int watchServerFile(struct Server *server, int file_descriptor, void *marker) {
+	struct epoll_event event;
+
+	event.events = EPOLLIN;
+	event.data.ptr = marker;
+	return epoll_ctl(server->epoll, EPOLL_CTL_ADD, file_descriptor, &event);
+}
+
+/******************************************************************************
+ * Function Name: runServer
+ * Description: Listen on the configured socket and serve games of the world
+ *   on the requested number of worker threads, the calling thread included,
+ *   until SIGINT or SIGTERM. The open file limit is raised as far as allowed
+ *   since every session holds a socket. Returns the process exit status.
+ *****************************************************************************/
+int runServer(const struct World *world, const struct ServerConfig *config) {
+	struct Server server;
+	struct sockaddr_un address;
+	struct rlimit limit;
+	sigset_t signalSet;
+	pthread_t *threads;
+	int numThreads = config->numThreads > 0 ? config->numThreads : sysconf(_SC_NPROCESSORS_ONLN),
+		i = 0;
+
+	memset(&server, 0, sizeof(server));
+	server.world = world;
+	initPathOracle(&server.oracle, world, 1);
+	if (numThreads < 1) {
+		numThreads = 1;
+	}
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	// workers learn of SIGINT and SIGTERM through the event loop
+	sigemptyset(&signalSet);
+	sigaddset(&signalSet, SIGINT);
+	sigaddset(&signalSet, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &signalSet, NULL);
+	server.signals = signalfd(-1, &signalSet, SFD_CLOEXEC);
+
+	// listen on the socket, replacing any left by an earlier server
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(config->socketName) >= sizeof(address.sun_path)) {
+		fprintf(stderr, "Socket name %s is too long.\n", config->socketName);
+		return 1;
+	}
+	strcpy(address.sun_path, config->socketName);
+	unlink(config->socketName);
+	server.listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (server.listener == -1 || server.signals == -1 ||
+	    bind(server.listener, (struct sockaddr *)&address, sizeof(address)) == -1 ||
+	    listen(server.listener, SOMAXCONN) == -1) {
+		fprintf(stderr, "Could not listen on %s: %s\n", config->socketName, strerror(errno));
+		return 1;
+	}
+	server.epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (server.epoll == -1 || watchServerFile(&server, server.listener, &server.listener) == -1 ||
+	    watchServerFile(&server, server.signals, &server.signals) == -1) {
+		fprintf(stderr, "Could not start the event loop: %s\n", strerror(errno));
+		return 1;
+	}
+
+	printf("serving %d rooms on %s with %d threads\n", world->numRooms, config->socketName, numThreads);
+	fflush(stdout);
+	threads = malloc(sizeof(pthread_t) * numThreads);
+	if (threads == NULL) {
+		fprintf(stderr, "Could not allocate %d threads.\n", numThreads);
+		return 1;
+	}
+	for (i = 1; i < numThreads; i++) {
+		if (pthread_create(&threads[i], NULL, serverThread, &server) != 0) {
+			fprintf(stderr, "Could not start server thread %d.\n", i);
+			numThreads = i;
+			break;
+		}
+	}
+	serverThread(&server);
+	for (i = 1; i < numThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	// sessions still open are dropped along with the process
+	printf("served %ld sessions, %ld won, %ld moves, %ld still open\n",
+	       server.numSessions, server.numWon, server.numMoves, server.numActive);
+	unlink(config->socketName);
+	close(server.listener);
+	close(server.signals);
+	close(server.epoll);
+	free(threads);
+	freePathOracle(&server.oracle);
+	return 0;
+}
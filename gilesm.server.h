@@ -0,0 +1,35 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.server.h
+ * Description: Game server. One process generates or loads a single world
+ *   and serves any number of players over a local Unix domain socket, so
+ *   players no longer cost a process, a world, and a directory of files
+ *   each. Every connection is one game played with the same text as the
+ *   interactive game: the server sends the room prompt, the client sends
+ *   room names one per line, and the connection is closed after the
+ *   results of a won game are sent.
+ *
+ *   The world is never changed while it is served, so every worker thread
+ *   reads it without locking. All workers run the same epoll event loop;
+ *   connections are registered one-shot, so a ready session is handed to
+ *   exactly one worker, and a session holds nothing but its current room,
+ *   its step list, and its partial input line. Every room's distance to the
+ *   end room is recorded once at startup, so hints and scores are lookups
+ *   that share the world's read-only treatment.
+ *****************************************************************************/
+#ifndef GILESM_SERVER_H
+#define GILESM_SERVER_H
+
+#include "gilesm.world.h"
+
+#define SESSION_LINE_SIZE 128			// longest room name a client may send
+
+struct ServerConfig {
+	const char *socketName;				// path of the Unix domain socket
+	int numThreads;						// worker threads running the event loop
+};
+
+// serve games of a world until interrupted, returns the process exit status
+int runServer(const struct World *world, const struct ServerConfig *config);
+
+#endif
@@ -0,0 +1,205 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.stats.c
+ * Description: Runtime instrumentation described in gilesm.stats.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gilesm.stats.h"
+
+int statsEnabled = 0;
+
+static struct Stats stats;
+
+static const char *timerNames[STAT_NUM_TIMERS] = {
+	"initGame", "buildGame", "pickName", "addSpanningConns", "addRoomConn",
+	"writeWorldFile", "loadWorldFile", "writeRoomFile", "exportRoomFiles",
+	"readRoomFile", "writeStepTrace", "writeTraceLog", "move"
+};
+
+static const char *counterNames[STAT_NUM_COUNTERS] = {
+	"connRefusals", "connFailures", "connRepairs", "unknownRooms"
+};
+
+static const char *ioNames[STAT_NUM_IO] = {
+	"roomFiles", "worldFile", "stepTrace", "traceLog", "terminal"
+};
+
+// print the report once the process is done
+static void printStatsAtExit(void) {
+	printStats(stderr, stats.format);
+}
+
+/******************************************************************************
+ * Function Name: enableStats
+ * Description: Turn on recording for the rest of the process and arrange for
+ *   the report to be printed to stderr in the specified format at exit, by
+ *   any path that runs exit handlers.
+ *****************************************************************************/
+void enableStats(enum StatFormat format) {
+	if (!statsEnabled) {
+		stats.format = format;
+		statsEnabled = 1;
+		atexit(printStatsAtExit);
+	}
+}
+
+/******************************************************************************
+ * Function Name: parseStatFormat
+ * Description: Read a report format name. Returns 0 on success, or -1 after
+ *   explaining on stderr.
+ *****************************************************************************/
+int parseStatFormat(const char *name, enum StatFormat *format) {
+	if (strcmp(name, "text") == 0) {
+		*format = STAT_FORMAT_TEXT;
+	} else if (strcmp(name, "json") == 0) {
+		*format = STAT_FORMAT_JSON;
+	} else {
+		fprintf(stderr, "Unknown stats format %s, use text or json.\n", name);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: readStatClock
+ * Description: Returns the monotonic clock in nanoseconds. A reading of 0 is
+ *   moved to 1 so that 0 can always mean recording was off.
+ *****************************************************************************/
+uint64_t readStatClock(void) {
+	struct timespec now;
+	uint64_t nanoseconds;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	nanoseconds = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+	return nanoseconds != 0 ? nanoseconds : 1;
+}
+
+/******************************************************************************
+ * Function Name: recordStatTime
+ * Description: Add one run of a phase, from start until now, to its timer.
+ *****************************************************************************/
+void recordStatTime(enum StatTimerId id, uint64_t start) {
+	struct StatTimer *timer = &stats.timers[id];
+	uint64_t elapsed = readStatClock() - start,
+			 longest = __atomic_load_n(&timer->maxNs, __ATOMIC_RELAXED);
+	int bucket = elapsed > 0 ? 63 - __builtin_clzll(elapsed) : 0;
+
+	__atomic_fetch_add(&timer->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&timer->totalNs, elapsed, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&timer->buckets[bucket], 1, __ATOMIC_RELAXED);
+	while (elapsed > longest &&
+	       !__atomic_compare_exchange_n(&timer->maxNs, &longest, elapsed, 1,
+	                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	}
+}
+
+/******************************************************************************
+ * Function Name: addStatCount
+ * Description: Add an amount to an event counter.
+ *****************************************************************************/
+void addStatCount(enum StatCounterId id, uint64_t amount) {
+	__atomic_fetch_add(&stats.counters[id], amount, __ATOMIC_RELAXED);
+}
+
+/******************************************************************************
+ * Function Name: addStatIo
+ * Description: Add system calls and bytes to the counters of a kind of file.
+ *****************************************************************************/
+void addStatIo(enum StatIoId id, uint64_t numCalls, uint64_t numBytes) {
+	__atomic_fetch_add(&stats.io[id].numCalls, numCalls, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats.io[id].numBytes, numBytes, __ATOMIC_RELAXED);
+}
+
+// duration below which the fraction of a timer's runs fall, interpolated
+// within its power of two bucket and never above the longest run
+static uint64_t findStatPercentile(const struct StatTimer *timer, double fraction) {
+	uint64_t seen = 0,
+			 wanted = (uint64_t)(timer->count * fraction),
+			 low,
+			 high,
+			 estimate;
+	int bucket = 0;
+
+	for (bucket = 0; bucket < STAT_NUM_BUCKETS - 1; bucket++) {
+		if (seen + timer->buckets[bucket] > wanted) {
+			break;
+		}
+		seen += timer->buckets[bucket];
+	}
+	// the bucket holds durations from its power of two up to the next one,
+	// taken as spread evenly across it
+	low = bucket > 0 ? 1ULL << bucket : 0;
+	high = bucket < 63 ? (2ULL << bucket) - 1 : UINT64_MAX;
+	estimate = low;
+	if (timer->buckets[bucket] > 0) {
+		estimate += (uint64_t)((double)(high - low) * (wanted - seen + 1) / timer->buckets[bucket]);
+	}
+	return estimate < timer->maxNs ? estimate : timer->maxNs;
+}
+
+/******************************************************************************
+ * Function Name: printStats
+ * Description: Print every timer that ran, every counter, and every kind of
+ *   file touched, either as a table or as one JSON object on one line. Times
+ *   are in nanoseconds, with the 50th and 99th percentiles estimated within
+ *   their power of two bucket.
+ *****************************************************************************/
+void printStats(FILE *stream, enum StatFormat format) {
+	const struct StatTimer *timer;
+	int i = 0,
+		first = 1;
+
+	if (format == STAT_FORMAT_JSON) {
+		fprintf(stream, "{\"timers\":{");
+		for (i = 0; i < STAT_NUM_TIMERS; i++) {
+			timer = &stats.timers[i];
+			if (timer->count == 0) {
+				continue;
+			}
+			fprintf(stream, "%s\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"mean_ns\":%llu,"
+			        "\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu}",
+			        first ? "" : ",", timerNames[i], (unsigned long long)timer->count,
+			        (unsigned long long)timer->totalNs, (unsigned long long)(timer->totalNs / timer->count),
+			        (unsigned long long)findStatPercentile(timer, 0.5),
+			        (unsigned long long)findStatPercentile(timer, 0.99), (unsigned long long)timer->maxNs);
+			first = 0;
+		}
+		fprintf(stream, "},\"counters\":{");
+		for (i = 0; i < STAT_NUM_COUNTERS; i++) {
+			fprintf(stream, "%s\"%s\":%llu", i == 0 ? "" : ",", counterNames[i],
+			        (unsigned long long)stats.counters[i]);
+		}
+		fprintf(stream, "},\"io\":{");
+		for (i = 0; i < STAT_NUM_IO; i++) {
+			fprintf(stream, "%s\"%s\":{\"calls\":%llu,\"bytes\":%llu}", i == 0 ? "" : ",", ioNames[i],
+			        (unsigned long long)stats.io[i].numCalls, (unsigned long long)stats.io[i].numBytes);
+		}
+		fprintf(stream, "}}\n");
+		return;
+	}
+
+	fprintf(stream, "%-18s %10s %14s %12s %12s %12s %12s\n",
+	        "timer", "count", "total ns", "mean ns", "p50 ns", "p99 ns", "max ns");
+	for (i = 0; i < STAT_NUM_TIMERS; i++) {
+		timer = &stats.timers[i];
+		if (timer->count == 0) {
+			continue;
+		}
+		fprintf(stream, "%-18s %10llu %14llu %12llu %12llu %12llu %12llu\n", timerNames[i],
+		        (unsigned long long)timer->count, (unsigned long long)timer->totalNs,
+		        (unsigned long long)(timer->totalNs / timer->count),
+		        (unsigned long long)findStatPercentile(timer, 0.5),
+		        (unsigned long long)findStatPercentile(timer, 0.99), (unsigned long long)timer->maxNs);
+	}
+	for (i = 0; i < STAT_NUM_COUNTERS; i++) {
+		fprintf(stream, "%-18s %10llu\n", counterNames[i], (unsigned long long)stats.counters[i]);
+	}
+	fprintf(stream, "%-18s %10s %14s\n", "io", "calls", "bytes");
+	for (i = 0; i < STAT_NUM_IO; i++) {
+		fprintf(stream, "%-18s %10llu %14llu\n", ioNames[i],
+		        (unsigned long long)stats.io[i].numCalls, (unsigned long long)stats.io[i].numBytes);
+	}
+}
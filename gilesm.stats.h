@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.stats.h
+ * Description: Runtime instrumentation of the game's hot paths. Timers
+ *   record how often and how long each phase of building, saving, loading,
+ *   and playing a world runs; counters record events such as connections a
+ *   room refused; and I/O counters record the system calls and bytes spent
+ *   on each kind of file.
+ *
+ *   The instrumentation is always compiled in but off until enableStats is
+ *   called, as --stats does. While it is off every probe is an inline test
+ *   of one global flag and nothing else, not even a clock read. While it is
+ *   on, probes add to shared totals with relaxed atomics, so any thread may
+ *   record, and the report is printed to stderr when the process exits.
+ *
+ *   Each timer keeps its durations in power of two buckets, so the report's
+ *   percentiles are estimates within a factor of two, interpolated inside
+ *   their bucket and capped at the longest run.
+ *****************************************************************************/
+#ifndef GILESM_STATS_H
+#define GILESM_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define STAT_NUM_BUCKETS 64					// one per power of two nanoseconds
+
+enum StatTimerId {
+	STAT_INIT_GAME,						// initGame
+	STAT_BUILD_GAME,					// buildGame, everything below included
+	STAT_PICK_NAME,						// one room name drawn
+	STAT_SPANNING_CONNS,				// addSpanningConns
+	STAT_ADD_ROOM_CONN,					// one addRoomConn call
+	STAT_WRITE_WORLD_FILE,				// writeWorldFile
+	STAT_LOAD_WORLD_FILE,				// loadWorldFile
+	STAT_WRITE_ROOM_FILE,				// writeRoomFile
+	STAT_EXPORT_ROOM_FILES,				// exportRoomFiles, every room
+	STAT_READ_ROOM_FILE,				// readRoomFile
+	STAT_WRITE_STEP_TRACE,				// writeStepTrace
+	STAT_WRITE_TRACE_LOG,				// one batch of game records written
+	STAT_MOVE,							// one move, from input to the next prompt
+	STAT_NUM_TIMERS
+};
+
+enum StatCounterId {
+	STAT_CONN_REFUSALS,					// rooms that refused an addRoomConn link
+	STAT_CONN_FAILURES,					// addRoomConn calls that found no room
+	STAT_CONN_REPAIRS,					// rooms topped up by rewiring other connections
+	STAT_UNKNOWN_ROOMS,					// moves naming no connected room
+	STAT_NUM_COUNTERS
+};
+
+enum StatIoId {
+	STAT_IO_ROOM_FILES,					// text room files
+	STAT_IO_WORLD_FILE,					// binary world files
+	STAT_IO_STEP_TRACE,					// step history written with --trace
+	STAT_IO_TRACE_LOG,					// game records appended with --trace-log
+	STAT_IO_TERMINAL,					// commands read and screens written
+	STAT_NUM_IO
+};
+
+enum StatFormat {
+	STAT_FORMAT_TEXT,					// aligned table for people
+	STAT_FORMAT_JSON					// one JSON object for tools
+};
+
+struct StatTimer {
+	uint64_t count;						// times the phase ran
+	uint64_t totalNs;					// nanoseconds across all runs
+	uint64_t maxNs;						// longest run
+	uint64_t buckets[STAT_NUM_BUCKETS];	// runs by highest bit of their duration
+};
+
+struct StatIo {
+	uint64_t numCalls;					// system calls made
+	uint64_t numBytes;					// bytes read or written
+};
+
+struct Stats {
+	struct StatTimer timers[STAT_NUM_TIMERS];
+	uint64_t counters[STAT_NUM_COUNTERS];
+	struct StatIo io[STAT_NUM_IO];
+	enum StatFormat format;				// how the exit report is printed
+};
+
+// set by enableStats; every probe tests it first
+extern int statsEnabled;
+
+// turn on recording and print a report in the format when the process exits
+void enableStats(enum StatFormat format);
+// parse "text" or "json", returns 0 on success or -1
+int parseStatFormat(const char *name, enum StatFormat *format);
+// monotonic clock in nanoseconds, never 0
+uint64_t readStatClock(void);
+// add one run that started at start to a timer
+void recordStatTime(enum StatTimerId id, uint64_t start);
+// add an amount to a counter
+void addStatCount(enum StatCounterId id, uint64_t amount);
+// add system calls and bytes to an I/O counter
+void addStatIo(enum StatIoId id, uint64_t numCalls, uint64_t numBytes);
+// print everything recorded so far
+void printStats(FILE *stream, enum StatFormat format);
+
+// start of a timed run, or 0 while recording is off
+static inline uint64_t startStatTimer(void) {
+	return statsEnabled ? readStatClock() : 0;
+}
+
+// end of a timed run started with startStatTimer
+static inline void stopStatTimer(enum StatTimerId id, uint64_t start) {
+	if (start != 0) {
+		recordStatTime(id, start);
+	}
+}
+
+// count an event while recording is on
+static inline void countStat(enum StatCounterId id, uint64_t amount) {
+	if (statsEnabled) {
+		addStatCount(id, amount);
+	}
+}
+
+// count file system calls and bytes while recording is on
+static inline void countStatIo(enum StatIoId id, uint64_t numCalls, uint64_t numBytes) {
+	if (statsEnabled) {
+		addStatIo(id, numCalls, numBytes);
+	}
+}
+
+#endif
@@ -0,0 +1,253 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.stream.c
+ * Description: Streaming worlds described in gilesm.stream.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gilesm.world.h"
+#include "gilesm.random.h"
+#include "gilesm.stream.h"
+
+// share of the grid links outside the spanning tree that are joined
+#define STREAM_LINK_PERCENT 40
+
+// keep the random choices made for different purposes unrelated
+#define STREAM_PARENT_SALT 0x70617265ULL
+#define STREAM_LINK_SALT 0x6C696E6BULL
+#define STREAM_NAME_SALT 0x6E616D65ULL
+#define STREAM_GOAL_SALT 0x676F616CULL
+
+struct StreamWorld {
+	uint64_t seed;						// decides every room of the world
+	int goalRoomIndex;					// end room, goalDistance from the start
+	const struct NameList *nameList;	// names rooms are drawn from
+};
+
+// rooms closer to the start than the specified ring
+static int64_t countRingRooms(int distance) {
+	return distance == 0 ? 0 : 1 + 2 * (int64_t)distance * (distance - 1);
+}
+
+/******************************************************************************
+ * Function Name: findCellRoom
+ * Description: Returns the index of the room on the grid cell (x, y), or -1
+ *   if the cell is beyond the last ring. Each ring is numbered from its
+ *   point on the positive x axis around through the four quadrants.
+ *****************************************************************************/
+static int findCellRoom(int x, int y) {
+	int distance = abs(x) + abs(y),
+		position;
+
+	if (distance == 0) {
+		return 0;
+	}
+	if (distance > STREAM_MAX_DISTANCE) {
+		return -1;
+	}
+	if (x > 0 && y >= 0) {
+		position = y;
+	} else if (x <= 0 && y > 0) {
+		position = distance - x;
+	} else if (x < 0 && y <= 0) {
+		position = 2 * distance - y;
+	} else {
+		position = 3 * distance + x;
+	}
+	return countRingRooms(distance) + position;
+}
+
+/******************************************************************************
+ * Function Name: findRoomCell
+ * Description: Store the grid cell of a room, the inverse of findCellRoom,
+ *   and return its ring. The ring is found by binary search over the ring
+ *   start indices.
+ *****************************************************************************/
+static int findRoomCell(int roomIndex, int *x, int *y) {
+	int low = 0,
+		high = STREAM_MAX_DISTANCE,
+		middle,
+		distance,
+		quadrant,
+		offset;
+
+	// the last ring that starts at or before the room
+	while (low < high) {
+		middle = (low + high + 1) / 2;
+		if (countRingRooms(middle) <= roomIndex) {
+			low = middle;
+		} else {
+			high = middle - 1;
+		}
+	}
+	distance = low;
+	if (distance == 0) {
+		*x = 0;
+		*y = 0;
+		return 0;
+	}
+	offset = roomIndex - countRingRooms(distance);
+	quadrant = offset / distance;
+	offset %= distance;
+	switch (quadrant) {
+	case 0:
+		*x = distance - offset;
+		*y = offset;
+		break;
+	case 1:
+		*x = -offset;
+		*y = distance - offset;
+		break;
+	case 2:
+		*x = offset - distance;
+		*y = -offset;
+		break;
+	default:
+		*x = offset;
+		*y = offset - distance;
+		break;
+	}
+	return distance;
+}
+
+/******************************************************************************
+ * Function Name: findParentCell
+ * Description: Store the neighbor of a cell one step closer to the start,
+ *   the cell's parent in the world's spanning tree. A cell off both axes
+ *   has two such neighbors and its room's random bits choose between them.
+ *****************************************************************************/
+static void findParentCell(uint64_t seed, int x, int y, int *parentX, int *parentY) {
+	int stepX;
+
+	if (y == 0) {
+		stepX = 1;
+	} else if (x == 0) {
+		stepX = 0;
+	} else {
+		stepX = mixRandomSeed(seed ^ STREAM_PARENT_SALT, findCellRoom(x, y)) & 1;
+	}
+	*parentX = stepX ? x - (x > 0 ? 1 : -1) : x;
+	*parentY = stepX ? y : y - (y > 0 ? 1 : -1);
+}
+
+/******************************************************************************
+ * Function Name: isCellLinked
+ * Description: Returns 1 if two neighboring cells are joined. Cells are
+ *   always joined when one is the other's parent; otherwise the pair's
+ *   random bits decide, keyed by both rooms in order so the answer is the
+ *   same from either side.
+ *****************************************************************************/
+static int isCellLinked(uint64_t seed, int x, int y, int roomIndex, int otherX, int otherY, int otherIndex) {
+	int parentX,
+		parentY;
+	uint64_t key;
+
+	findParentCell(seed, x, y, &parentX, &parentY);
+	if ((x != 0 || y != 0) && parentX == otherX && parentY == otherY) {
+		return 1;
+	}
+	findParentCell(seed, otherX, otherY, &parentX, &parentY);
+	if ((otherX != 0 || otherY != 0) && parentX == x && parentY == y) {
+		return 1;
+	}
+	key = roomIndex < otherIndex ? ((uint64_t)roomIndex << 32) | (uint32_t)otherIndex
+	                             : ((uint64_t)otherIndex << 32) | (uint32_t)roomIndex;
+	return mixRandomSeed(seed ^ STREAM_LINK_SALT, key) % 100 < STREAM_LINK_PERCENT;
+}
+
+/******************************************************************************
+ * Function Name: readStreamRoom
+ * Description: Generate one room of a streaming world: its type, a name
+ *   drawn from the dictionary and made unique with the room index, and its
+ *   links to the four grid neighbors, listed east, north, west, south.
+ *   Returns 0 on success or -1 for an index outside the world.
+ *****************************************************************************/
+static int readStreamRoom(void *data, int roomIndex, struct RoomRecord *record) {
+	static const int stepX[4] = { 1, 0, -1, 0 },
+					 stepY[4] = { 0, 1, 0, -1 };
+	const struct StreamWorld *stream = data;
+	const struct NameList *list = stream->nameList;
+	int x,
+		y,
+		otherIndex,
+		nameIndex,
+		i = 0;
+
+	if (roomIndex < 0 || roomIndex >= countRingRooms(STREAM_MAX_DISTANCE + 1)) {
+		return -1;
+	}
+	findRoomCell(roomIndex, &x, &y);
+	growRoomRecord(record, ROOM_NAME_SIZE - 1, 4);
+
+	// join each neighbor inside the world whose link is open
+	record->numConns = 0;
+	for (i = 0; i < 4; i++) {
+		otherIndex = findCellRoom(x + stepX[i], y + stepY[i]);
+		if (otherIndex != -1 &&
+		    isCellLinked(stream->seed, x, y, roomIndex, x + stepX[i], y + stepY[i], otherIndex)) {
+			record->conns[record->numConns++] = otherIndex;
+		}
+	}
+
+	// dictionary names cannot contain '#', so the suffix keeps names unique
+	nameIndex = mixRandomSeed(stream->seed ^ STREAM_NAME_SALT, roomIndex) % list->numNames;
+	record->nameLength = snprintf(record->name, record->nameCapacity, "%s #%d",
+	                              list->text + list->nameOffsets[nameIndex], roomIndex);
+	if (roomIndex == 0) {
+		record->type = START_ROOM;
+	} else if (roomIndex == stream->goalRoomIndex) {
+		record->type = END_ROOM;
+	} else {
+		record->type = MID_ROOM;
+	}
+	record->roomIndex = roomIndex;
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: openStreamRoomSource
+ * Description: Open the streaming world of a seed as a room source, with
+ *   the end room goalDistance moves from the start. Only the world's
+ *   settings are kept; rooms are generated as they are read. Returns 0 on
+ *   success or -1 if the distance is out of range.
+ *****************************************************************************/
+int openStreamRoomSource(struct RoomSource *source, uint64_t seed, int goalDistance,
+                         const struct NameList *nameList) {
+	struct StreamWorld *stream;
+
+	if (goalDistance < 1 || goalDistance > STREAM_MAX_DISTANCE) {
+		fprintf(stderr, "The goal must be from 1 to %d moves away.\n", STREAM_MAX_DISTANCE);
+		return -1;
+	}
+	stream = malloc(sizeof(struct StreamWorld));
+	if (stream == NULL) {
+		fprintf(stderr, "Could not allocate a room source.\n");
+		return -1;
+	}
+	stream->seed = seed;
+	stream->nameList = nameList != NULL ? nameList : getDefaultNameList();
+	stream->goalRoomIndex = countRingRooms(goalDistance) +
+	                        mixRandomSeed(seed ^ STREAM_GOAL_SALT, goalDistance) % (4 * goalDistance);
+
+	source->numRooms = countRingRooms(STREAM_MAX_DISTANCE + 1);
+	source->startRoomIndex = 0;
+	source->endRoomIndex = stream->goalRoomIndex;
+	source->data = stream;
+	source->readRoom = readStreamRoom;
+	source->closeSource = free;
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: getStreamDistance
+ * Description: Returns the fewest moves from the start room to a room of a
+ *   streaming world, which is its ring because every room is joined to one
+ *   a ring closer and no link skips a ring.
+ *****************************************************************************/
+int getStreamDistance(int roomIndex) {
+	int x,
+		y;
+
+	return findRoomCell(roomIndex, &x, &y);
+}
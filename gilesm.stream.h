@@ -0,0 +1,38 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.stream.h
+ * Description: Open-ended worlds generated room by room as they are reached.
+ *   A streaming world is never built or stored: every room, its name, and
+ *   its connections are computed from the world seed and the room's index
+ *   when the room cache asks for them, so two games with the same seed
+ *   always walk the same world, and memory and startup cost only depend on
+ *   how many rooms the cache holds.
+ *
+ *   Rooms sit on the cells of an unbounded grid, numbered ring by ring
+ *   outward from the start room at the origin, so rooms near the start have
+ *   small indices. Every room is joined to a neighbor one step closer to the
+ *   start, which makes the world connected and makes a room's distance from
+ *   the start exactly the number of grid steps to it. Other grid neighbors
+ *   are joined at random. The end room is picked on the ring at the
+ *   requested distance, so the shortest path to it is always that long.
+ *
+ *   Room indices are ints, which holds rings out to STREAM_MAX_DISTANCE
+ *   steps from the start, more than two billion rooms.
+ *****************************************************************************/
+#ifndef GILESM_STREAM_H
+#define GILESM_STREAM_H
+
+#include <stdint.h>
+#include "gilesm.names.h"
+#include "gilesm.roomcache.h"
+
+#define STREAM_MAX_DISTANCE 32767		// farthest ring that fits an int index
+#define STREAM_GOAL_DISTANCE 10			// steps to the end room unless told otherwise
+
+// open a streaming world as a room source, returns 0 on success or -1
+int openStreamRoomSource(struct RoomSource *source, uint64_t seed, int goalDistance,
+                         const struct NameList *nameList);
+// fewest moves from the start room to a room of a streaming world
+int getStreamDistance(int roomIndex);
+
+#endif
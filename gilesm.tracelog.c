@@ -0,0 +1,467 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.tracelog.c
+ * Description: Shared game log and replay engine described in
+ *   gilesm.tracelog.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gilesm.adventure.h"
+#include "gilesm.stats.h"
+#include "gilesm.tracelog.h"
+
+struct TraceReader {
+	const unsigned char *next;			// next byte to decode
+	const unsigned char *end;			// first byte past the record
+};
+
+struct TraceRecord {
+	uint64_t seed;						// seed the world was built from
+	struct GameOptions options;			// settings the world was built with
+	uint64_t worldHash;					// hashWorld of the world played
+	uint64_t startTime;					// microseconds since the epoch at the start
+	int startRoom;						// room the game started in
+};
+
+// microseconds on the specified clock
+static uint64_t readMicroseconds(clockid_t clock) {
+	struct timespec now;
+
+	clock_gettime(clock, &now);
+	return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// seconds elapsed on the monotonic clock
+static double getSeconds(void) {
+	return readMicroseconds(CLOCK_MONOTONIC) / 1e6;
+}
+
+// make room in the log's buffer for the specified number of bytes more
+static void reserveTrace(struct TraceLog *log, size_t needed) {
+	if (log->length + needed > log->capacity) {
+		while (log->length + needed > log->capacity) {
+			log->capacity *= 2;
+		}
+		log->buffer = realloc(log->buffer, log->capacity);
+		if (log->buffer == NULL) {
+			fprintf(stderr, "Could not allocate %zu bytes of trace log.\n", log->capacity);
+			exit(1);
+		}
+	}
+}
+
+// append a value as a varint: 7 bits per byte, low bits first
+static void putVarint(struct TraceLog *log, uint64_t value) {
+	unsigned char *out;
+
+	reserveTrace(log, 10);
+	out = (unsigned char *)log->buffer + log->length;
+	while (value >= 0x80) {
+		*out++ = (unsigned char)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (unsigned char)value;
+	log->length = out - (unsigned char *)log->buffer;
+}
+
+// store a value as the specified number of little endian bytes
+static void storeFixed(unsigned char *out, uint64_t value, int numBytes) {
+	int i = 0;
+
+	for (i = 0; i < numBytes; i++) {
+		out[i] = (unsigned char)(value >> (8 * i));
+	}
+}
+
+// append a value as the specified number of little endian bytes
+static void putFixed(struct TraceLog *log, uint64_t value, int numBytes) {
+	reserveTrace(log, numBytes);
+	storeFixed((unsigned char *)log->buffer + log->length, value, numBytes);
+	log->length += numBytes;
+}
+
+/******************************************************************************
+ * Function Name: openTraceLog
+ * Description: Open a log for appending, creating it if it does not exist,
+ *   with an empty batch. Returns 0 on success or -1.
+ *****************************************************************************/
+int openTraceLog(struct TraceLog *log, const char *fileName) {
+	memset(log, 0, sizeof(*log));
+	log->fileDescriptor = open(fileName, O_WRONLY | O_CREAT | O_APPEND, 0664);
+	if (log->fileDescriptor == -1) {
+		fprintf(stderr, "Could not open trace log %s: %s\n", fileName, strerror(errno));
+		return -1;
+	}
+	log->capacity = TRACE_LOG_BATCH_SIZE;
+	log->buffer = malloc(log->capacity);
+	if (log->buffer == NULL) {
+		fprintf(stderr, "Could not allocate %zu bytes of trace log.\n", log->capacity);
+		exit(1);
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: beginTraceRecord
+ * Description: Start the record of a game in a world built from the seed and
+ *   connection bounds given, discarding any record left open. The length is
+ *   filled in by endTraceRecord.
+ *****************************************************************************/
+void beginTraceRecord(struct TraceLog *log, const struct World *world, uint64_t seed,
+                      int minConn, int maxConn) {
+	if (log->recordOpen) {
+		log->length = log->recordStart;
+	}
+	log->recordStart = log->length;
+	log->recordOpen = 1;
+	putFixed(log, TRACE_RECORD_MARKER, 1);
+	putFixed(log, TRACE_RECORD_VERSION, 1);
+	putFixed(log, 0, 4);
+	putFixed(log, seed, 8);
+	putVarint(log, world->numRooms);
+	putVarint(log, minConn);
+	putVarint(log, maxConn);
+	putFixed(log, hashWorld(world), 8);
+	putVarint(log, readMicroseconds(CLOCK_REALTIME));
+	putVarint(log, world->startRoomIndex);
+	log->lastRoom = world->startRoomIndex;
+	log->lastTime = readMicroseconds(CLOCK_MONOTONIC);
+}
+
+/******************************************************************************
+ * Function Name: addTraceStep
+ * Description: Add a move to the open record: the distance from the previous
+ *   room's index, zigzag encoded so small steps either way stay small, then
+ *   the microseconds since the previous move.
+ *****************************************************************************/
+void addTraceStep(struct TraceLog *log, int roomIndex) {
+	uint64_t now;
+	int64_t delta = (int64_t)roomIndex - log->lastRoom;
+
+	if (!log->recordOpen) {
+		return;
+	}
+	now = readMicroseconds(CLOCK_MONOTONIC);
+	putVarint(log, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+	putVarint(log, now - log->lastTime);
+	log->lastRoom = roomIndex;
+	log->lastTime = now;
+}
+
+/******************************************************************************
+ * Function Name: endTraceRecord
+ * Description: Fill in the open record's length and add it to the batch,
+ *   writing the batch once it holds TRACE_LOG_BATCH_SIZE bytes.
+ *****************************************************************************/
+void endTraceRecord(struct TraceLog *log) {
+	if (!log->recordOpen) {
+		return;
+	}
+	storeFixed((unsigned char *)log->buffer + log->recordStart + 2,
+	           log->length - log->recordStart - TRACE_RECORD_HEADER, 4);
+	log->recordOpen = 0;
+	log->numRecords++;
+	if (log->length >= TRACE_LOG_BATCH_SIZE) {
+		flushTraceLog(log);
+	}
+}
+
+/******************************************************************************
+ * Function Name: flushTraceLog
+ * Description: Append every finished record in the batch to the log with one
+ *   write, resuming after a short one, and keep any open record for the next
+ *   batch. A batch that cannot be written is dropped, and the log reports it
+ *   once. Returns 0 on success or -1.
+ *****************************************************************************/
+int flushTraceLog(struct TraceLog *log) {
+	size_t ready = log->recordOpen ? log->recordStart : log->length,
+		   written = 0;
+	ssize_t nwritten;
+	uint64_t start = startStatTimer();
+
+	while (written < ready) {
+		nwritten = write(log->fileDescriptor, log->buffer + written, ready - written);
+		countStatIo(STAT_IO_TRACE_LOG, 1, nwritten > 0 ? nwritten : 0);
+		log->numWrites++;
+		if (nwritten < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (!log->failed) {
+				fprintf(stderr, "Could not write trace log: %s\n", strerror(errno));
+			}
+			log->failed = 1;
+			break;
+		}
+		written += nwritten;
+		log->numBytes += nwritten;
+	}
+	// keep the open record at the front of the buffer
+	memmove(log->buffer, log->buffer + ready, log->length - ready);
+	log->length -= ready;
+	log->recordStart -= log->recordOpen ? ready : 0;
+	stopStatTimer(STAT_WRITE_TRACE_LOG, start);
+	return written < ready ? -1 : 0;
+}
+
+/******************************************************************************
+ * Function Name: closeTraceLog
+ * Description: Write the remaining finished records, discard any record left
+ *   open, and close the log. Returns 0 if every batch was written, or -1.
+ *****************************************************************************/
+int closeTraceLog(struct TraceLog *log) {
+	if (log->recordOpen) {
+		log->length = log->recordStart;
+		log->recordOpen = 0;
+	}
+	flushTraceLog(log);
+	close(log->fileDescriptor);
+	free(log->buffer);
+	log->buffer = NULL;
+	return log->failed ? -1 : 0;
+}
+
+// decode a varint, returns -1 if it runs past the record
+static int getVarint(struct TraceReader *reader, uint64_t *value) {
+	int shift = 0;
+
+	*value = 0;
+	while (reader->next < reader->end && shift < 64) {
+		*value |= (uint64_t)(*reader->next & 0x7f) << shift;
+		if ((*reader->next++ & 0x80) == 0) {
+			return 0;
+		}
+		shift += 7;
+	}
+	return -1;
+}
+
+// decode the specified number of little endian bytes, returns -1 if they run past the record
+static int getFixed(struct TraceReader *reader, uint64_t *value, int numBytes) {
+	int i = 0;
+
+	if (reader->end - reader->next < numBytes) {
+		return -1;
+	}
+	*value = 0;
+	for (i = 0; i < numBytes; i++) {
+		*value |= (uint64_t)reader->next[i] << (8 * i);
+	}
+	reader->next += numBytes;
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: walkTraceMoves
+ * Description: Walk the moves of one record through its rebuilt world from
+ *   the room it started in, counting moves, illegal ones, and revisits, and
+ *   the time between moves. seenStamps holds, per room, the last record
+ *   that visited it, so nothing is cleared between records. Returns the
+ *   room the game ended in, or -1 if the moves leave the world or the record.
+ *****************************************************************************/
+static int walkTraceMoves(struct TraceReader *reader, const struct World *world, int currentRoom,
+                          long *seenStamps, long stamp, struct TraceReplay *replay) {
+	uint64_t delta,
+			 gap;
+	int64_t nextRoom;
+
+	seenStamps[currentRoom] = stamp;
+	while (reader->next < reader->end) {
+		if (getVarint(reader, &delta) == -1 || getVarint(reader, &gap) == -1) {
+			return -1;
+		}
+		nextRoom = currentRoom + ((int64_t)(delta >> 1) ^ -(int64_t)(delta & 1));
+		if (nextRoom < 0 || nextRoom >= world->numRooms) {
+			return -1;
+		}
+		if (!isConnected(world, currentRoom, nextRoom)) {
+			replay->numIllegal++;
+		}
+		if (seenStamps[nextRoom] == stamp) {
+			replay->numRevisits++;
+		}
+		seenStamps[nextRoom] = stamp;
+		replay->numMoves++;
+		replay->totalGap += gap;
+		replay->maxGap = gap > replay->maxGap ? gap : replay->maxGap;
+		currentRoom = nextRoom;
+	}
+	return currentRoom;
+}
+
+/******************************************************************************
+ * Function Name: readTraceRecord
+ * Description: Decode the header of the record at the front of a log image
+ *   and point a reader at its moves. Returns 0, or -1 if the record is
+ *   damaged or runs past the end of the image.
+ *****************************************************************************/
+static int readTraceRecord(const unsigned char *next, const unsigned char *end,
+                           struct TraceRecord *record, struct TraceReader *moves) {
+	struct TraceReader reader = { next + 2, end };
+	uint64_t values[4];
+
+	if (end - next < TRACE_RECORD_HEADER || next[0] != TRACE_RECORD_MARKER ||
+	    next[1] != TRACE_RECORD_VERSION || getFixed(&reader, &values[0], 4) == -1 ||
+	    values[0] > (uint64_t)(end - reader.next)) {
+		return -1;
+	}
+	reader.end = reader.next + values[0];
+	if (getFixed(&reader, &record->seed, 8) == -1 || getVarint(&reader, &values[0]) == -1 ||
+	    getVarint(&reader, &values[1]) == -1 || getVarint(&reader, &values[2]) == -1 ||
+	    getFixed(&reader, &record->worldHash, 8) == -1 || getVarint(&reader, &record->startTime) == -1 ||
+	    getVarint(&reader, &values[3]) == -1 || values[0] > INT32_MAX || values[1] > INT32_MAX ||
+	    values[2] > INT32_MAX || values[3] >= values[0]) {
+		return -1;
+	}
+	record->options.numRooms = values[0];
+	record->options.minConn = values[1];
+	record->options.maxConn = values[2];
+	record->startRoom = values[3];
+	*moves = reader;
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: replayTraceLog
+ * Description: Map a log and replay its records in order. Each record's world
+ *   is rebuilt with initGame and buildGame from its seed and settings, or
+ *   kept from the previous record if they match, and must have the recorded
+ *   fingerprint and start room; the moves of a world that does not are not
+ *   walked. The worlds are rebuilt with the name list and engine of the
+ *   options given; the name list must be the one the games were played
+ *   with. Returns 0, or -1 if the log cannot be read or a record is damaged.
+ *****************************************************************************/
+int replayTraceLog(const char *fileName, const struct GameOptions *options, struct TraceReplay *replay) {
+	struct Game *currentGame = NULL;
+	struct TraceRecord record;
+	struct TraceReader moves;
+	struct GameOptions builtOptions;
+	struct stat fileInfo;
+	const unsigned char *base,
+						*next,
+						*end;
+	uint64_t builtSeed = 0,
+			 builtHash = 0;
+	long *seenStamps = NULL;
+	double markTime;
+	int file_descriptor,
+		endRoom,
+		result = 0;
+
+	memset(replay, 0, sizeof(*replay));
+	file_descriptor = open(fileName, O_RDONLY);
+	if (file_descriptor == -1 || fstat(file_descriptor, &fileInfo) == -1) {
+		fprintf(stderr, "Could not open trace log %s: %s\n", fileName, strerror(errno));
+		if (file_descriptor != -1) {
+			close(file_descriptor);
+		}
+		return -1;
+	}
+	if (fileInfo.st_size == 0) {
+		close(file_descriptor);
+		return 0;
+	}
+	base = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	close(file_descriptor);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "Could not map %s: %s\n", fileName, strerror(errno));
+		return -1;
+	}
+	madvise((void *)base, fileInfo.st_size, MADV_SEQUENTIAL);
+	memset(&builtOptions, 0, sizeof(builtOptions));
+
+	for (next = base, end = base + fileInfo.st_size; next < end; next = moves.end) {
+		record.options.nameList = options->nameList;
+		record.options.engine = options->engine;
+		if (readTraceRecord(next, end, &record, &moves) == -1 ||
+		    checkGameOptions(&record.options) == -1) {
+			fprintf(stderr, "Damaged trace record at offset %ld of %s.\n", (long)(next - base), fileName);
+			result = -1;
+			break;
+		}
+		// rebuild the world unless the previous record was played in it
+		markTime = getSeconds();
+		// the name list and engine are the same for every record
+		if (currentGame == NULL || record.seed != builtSeed ||
+		    record.options.numRooms != builtOptions.numRooms ||
+		    record.options.minConn != builtOptions.minConn ||
+		    record.options.maxConn != builtOptions.maxConn) {
+			if (currentGame == NULL) {
+				currentGame = malloc(sizeof(struct Game));
+				if (currentGame == NULL) {
+					fprintf(stderr, "Could not allocate a game.\n");
+					exit(1);
+				}
+			} else {
+				freeGame(currentGame);
+			}
+			initGame(currentGame, &record.options, record.seed);
+			buildGame(currentGame);
+			seenStamps = allocArena(&currentGame->arena, sizeof(long) * record.options.numRooms);
+			memset(seenStamps, 0, sizeof(long) * record.options.numRooms);
+			builtSeed = record.seed;
+			builtOptions = record.options;
+			builtHash = hashWorld(&currentGame->world);
+		}
+		replay->buildSeconds += getSeconds() - markTime;
+		replay->numRecords++;
+		replay->firstStart = replay->numRecords == 1 || record.startTime < replay->firstStart ?
+		                     record.startTime : replay->firstStart;
+		replay->lastStart = record.startTime > replay->lastStart ? record.startTime : replay->lastStart;
+		if (builtHash != record.worldHash || record.startRoom != currentGame->world.startRoomIndex) {
+			replay->numMismatched++;
+			continue;
+		}
+
+		// walk the moves through the rebuilt world
+		markTime = getSeconds();
+		endRoom = walkTraceMoves(&moves, &currentGame->world, record.startRoom, seenStamps,
+		                         replay->numRecords, replay);
+		replay->walkSeconds += getSeconds() - markTime;
+		if (endRoom == -1) {
+			fprintf(stderr, "Damaged trace record at offset %ld of %s.\n", (long)(next - base), fileName);
+			result = -1;
+			break;
+		}
+		if (endRoom == currentGame->world.endRoomIndex) {
+			replay->numFinished++;
+		}
+	}
+
+	if (currentGame != NULL) {
+		freeGame(currentGame);
+		free(currentGame);
+	}
+	munmap((void *)base, fileInfo.st_size);
+	return result;
+}
+
+/******************************************************************************
+ * Function Name: runTraceReplay
+ * Description: Replay a log and print what it holds, whether every game
+ *   replayed exactly, how the players moved, and the replay's throughput.
+ *   Returns the process exit status, 1 if the log is damaged or any game
+ *   did not replay exactly.
+ *****************************************************************************/
+int runTraceReplay(const char *fileName, const struct GameOptions *options) {
+	struct TraceReplay replay;
+	int result = replayTraceLog(fileName, options, &replay);
+
+	printf("replayed %ld games from %s: %ld moves, %ld finished\n",
+	       replay.numRecords, fileName, replay.numMoves, replay.numFinished);
+	printf("%ld worlds built differently, %ld illegal moves\n", replay.numMismatched, replay.numIllegal);
+	printf("revisits %.1f%% of moves, %.3f ms between moves on average, %.3f ms at most\n",
+	       replay.numMoves > 0 ? 100.0 * replay.numRevisits / replay.numMoves : 0.0,
+	       replay.numMoves > 0 ? replay.totalGap / 1e3 / replay.numMoves : 0.0, replay.maxGap / 1e3);
+	printf("games started over %.3f s\n", (replay.lastStart - replay.firstStart) / 1e6);
+	printf("build %.3f s, walk %.3f s, %.1f moves/sec\n", replay.buildSeconds, replay.walkSeconds,
+	       replay.walkSeconds > 0 ? replay.numMoves / replay.walkSeconds : 0.0);
+	return result == -1 || replay.numMismatched > 0 || replay.numIllegal > 0 ? 1 : 0;
+}
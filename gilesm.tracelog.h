@@ -0,0 +1,88 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.tracelog.h
+ * Description: Shared log of played games and the engine that replays it.
+ *   Each game is one record: the seed and settings its world was built
+ *   from, the world's fingerprint, the time and room it started in, and
+ *   then every move as the signed distance from the previous room's index
+ *   and the microseconds since the previous move, both as varints. Small
+ *   worlds and quick players take one byte for each, so a typical move costs
+ *   two bytes where a step trace spends four on the room alone.
+ *
+ *   A record starts with a marker byte, a version byte, and the length of
+ *   the rest as 4 little endian bytes; the seed and fingerprint are 8 little
+ *   endian bytes each; everything else is a varint. Records are gathered in
+ *   memory and appended TRACE_LOG_BATCH_SIZE bytes at a time with one write
+ *   to a file opened for appending, so any number of processes can log to
+ *   the same file and each write lands whole at its end.
+ *
+ *   Replay reads a log with one mmap, rebuilds each record's world with
+ *   buildGame, and walks its moves, checking that the world's fingerprint
+ *   matches and every move is legal, which together show generation is
+ *   deterministic. It also profiles the moves: how many revisit a room and
+ *   how long players take between them.
+ *****************************************************************************/
+#ifndef GILESM_TRACELOG_H
+#define GILESM_TRACELOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gilesm.world.h"
+#include "gilesm.names.h"
+
+struct GameOptions;
+
+#define TRACE_LOG_BATCH_SIZE 65536			// bytes gathered before each write
+#define TRACE_RECORD_MARKER 0xA7			// first byte of every record
+#define TRACE_RECORD_VERSION 1				// bumped whenever the layout changes
+#define TRACE_RECORD_HEADER 6				// marker, version, and body length
+
+struct TraceLog {
+	int fileDescriptor;					// log opened for appending
+	char *buffer;						// records not yet written
+	size_t length;						// bytes used in buffer
+	size_t capacity;					// bytes allocated for buffer
+	size_t recordStart;					// offset of the open record in buffer
+	int recordOpen;						// a record is being added to
+	int lastRoom;						// room of the record's latest move
+	uint64_t lastTime;					// microseconds of the latest move
+	long numRecords;					// records finished
+	long numWrites;						// write calls made
+	uint64_t numBytes;					// bytes written
+	int failed;							// a write failed and records were lost
+};
+
+struct TraceReplay {
+	long numRecords;					// records replayed
+	long numMismatched;					// worlds whose fingerprint differed
+	long numFinished;					// games whose last move reached the end
+	long numMoves;						// moves walked
+	long numIllegal;					// moves to a room not connected
+	long numRevisits;					// moves to a room already seen that game
+	uint64_t totalGap;					// microseconds between moves, summed
+	uint64_t maxGap;					// longest time between two moves
+	uint64_t firstStart;				// microseconds since the epoch of the first game
+	uint64_t lastStart;					// microseconds since the epoch of the last game
+	double buildSeconds;				// time spent rebuilding worlds
+	double walkSeconds;					// time spent decoding and walking moves
+};
+
+// open a log for appending, creating it if needed, returns 0 on success or -1
+int openTraceLog(struct TraceLog *log, const char *fileName);
+// start the record of a game played in a world built from a seed
+void beginTraceRecord(struct TraceLog *log, const struct World *world, uint64_t seed,
+                      int minConn, int maxConn);
+// add a move to the specified room to the open record
+void addTraceStep(struct TraceLog *log, int roomIndex);
+// finish the open record, writing the batch if it is full
+void endTraceRecord(struct TraceLog *log);
+// write every finished record, returns 0 on success or -1
+int flushTraceLog(struct TraceLog *log);
+// write what remains and close the log, returns 0 on success or -1
+int closeTraceLog(struct TraceLog *log);
+// replay every record of a log with the options' names and engine, returns 0 or -1 if unreadable
+int replayTraceLog(const char *fileName, const struct GameOptions *options, struct TraceReplay *replay);
+// replay a log and print its report, returns the process exit status
+int runTraceReplay(const char *fileName, const struct GameOptions *options);
+
+#endif
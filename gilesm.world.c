@@ -0,0 +1,537 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.world.c
+ * Description: Allocation and packing of the room graph described in
+ *   gilesm.world.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "gilesm.world.h"
+
+// text labels indexed by room type
+static const char *roomTypeNames[] = { "MID_ROOM", "START_ROOM", "END_ROOM" };
+
+// memory from an arena, or from the heap if there is none
+static void *allocWorldMemory(struct Arena *arena, size_t size) {
+	return arena != NULL ? allocArena(arena, size) : malloc(size);
+}
+
+/******************************************************************************
+ * Function Name: initWorld
+ * Description: Allocate a world with the specified number of rooms. Every
+ *   room starts without connections. With an arena, every array of the
+ *   world comes from it and is released with it, not by freeWorld.
+ *****************************************************************************/
+void initWorld(struct World *world, int numRooms, struct Arena *arena) {
+	world->numRooms = numRooms;
+	world->numConns = 0;
+	world->startRoomIndex = -1;
+	world->endRoomIndex = -1;
+	world->namePoolSize = 0;
+	world->namePoolCapacity = 0;
+	world->nameIndexSize = 0;
+	world->roomList = allocWorldMemory(arena, sizeof(struct Room) * numRooms);
+	world->connOffsets = allocWorldMemory(arena, sizeof(int) * (numRooms + 1));
+	world->connList = NULL;
+	world->namePool = NULL;
+	world->nameIndex = NULL;
+	world->mapAddress = NULL;
+	world->mapLength = 0;
+	world->arena = arena;
+	if (world->roomList == NULL || world->connOffsets == NULL) {
+		fprintf(stderr, "Could not allocate a world of %d rooms.\n", numRooms);
+		exit(1);
+	}
+	memset(world->roomList, 0, sizeof(struct Room) * numRooms);
+	memset(world->connOffsets, 0, sizeof(int) * (numRooms + 1));
+}
+
+/******************************************************************************
+ * Function Name: freeWorld
+ * Description: Release all memory held by a world.
+ *****************************************************************************/
+void freeWorld(struct World *world) {
+	// a mapped world's arrays all point into the mapping
+	if (world->mapAddress != NULL) {
+		munmap(world->mapAddress, world->mapLength);
+	} else if (world->arena == NULL) {
+		free(world->roomList);
+		free(world->connOffsets);
+		free(world->connList);
+		free(world->namePool);
+		free(world->nameIndex);
+	}
+	world->roomList = NULL;
+	world->connOffsets = NULL;
+	world->connList = NULL;
+	world->namePool = NULL;
+	world->nameIndex = NULL;
+	world->mapAddress = NULL;
+	world->mapLength = 0;
+	world->arena = NULL;
+	world->nameIndexSize = 0;
+	world->numRooms = 0;
+	world->numConns = 0;
+	world->namePoolSize = 0;
+	world->namePoolCapacity = 0;
+}
+
+/******************************************************************************
+ * Function Name: setRoomName
+ * Description: Append a copy of the name, with its terminator, to the world's
+ *   name pool and point the specified room at it along with the name's hash.
+ *   The pool doubles in size whenever it runs out of space.
+ *****************************************************************************/
+void setRoomName(struct World *world, int roomIndex, const char *name) {
+	int length = strlen(name);
+
+	// grow the pool until the name and its terminator fit
+	if (world->namePoolSize + length + 1 > world->namePoolCapacity) {
+		int capacity = world->namePoolCapacity > 0 ? world->namePoolCapacity : 256;
+		while (world->namePoolSize + length + 1 > capacity) {
+			capacity *= 2;
+		}
+		if (world->arena != NULL) {
+			world->namePool = growArena(world->arena, world->namePool, world->namePoolSize, capacity);
+		} else {
+			world->namePool = realloc(world->namePool, capacity);
+		}
+		if (world->namePool == NULL) {
+			fprintf(stderr, "Could not allocate %d bytes of room names.\n", capacity);
+			exit(1);
+		}
+		world->namePoolCapacity = capacity;
+	}
+	memcpy(world->namePool + world->namePoolSize, name, length + 1);
+	world->roomList[roomIndex].nameOffset = world->namePoolSize;
+	world->roomList[roomIndex].nameLength = length;
+	world->roomList[roomIndex].nameHash = hashRoomName(name, length);
+	world->namePoolSize += length + 1;
+}
+
+/******************************************************************************
+ * Function Name: hashRoomName
+ * Description: 32 bit FNV-1a hash of the specified number of name characters.
+ *****************************************************************************/
+unsigned int hashRoomName(const char *name, int length) {
+	unsigned int hash = 2166136261u;
+	int i = 0;
+
+	for (i = 0; i < length; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/******************************************************************************
+ * Function Name: indexRoomNames
+ * Description: Build the world's name index, an open addressing hash table of
+ *   room indices with linear probing. The table has at least twice as many
+ *   slots as rooms so probe runs stay short. If two rooms share a name, the
+ *   first one is found.
+ *****************************************************************************/
+void indexRoomNames(struct World *world) {
+	int size = 16,
+		mask,
+		slot,
+		i = 0;
+
+	while (size < world->numRooms * 2) {
+		size *= 2;
+	}
+	if (world->arena == NULL) {
+		free(world->nameIndex);
+	}
+	world->nameIndex = allocWorldMemory(world->arena, sizeof(int) * size);
+	if (world->nameIndex == NULL) {
+		fprintf(stderr, "Could not allocate a name index of %d slots.\n", size);
+		exit(1);
+	}
+	memset(world->nameIndex, -1, sizeof(int) * size);
+	world->nameIndexSize = size;
+	mask = size - 1;
+
+	// place each room in the first free slot after its hash
+	for (i = 0; i < world->numRooms; i++) {
+		const struct Room *room = &world->roomList[i];
+		const struct Room *other;
+		for (slot = room->nameHash & mask; world->nameIndex[slot] != -1; slot = (slot + 1) & mask) {
+			other = &world->roomList[world->nameIndex[slot]];
+			if (other->nameHash == room->nameHash && other->nameLength == room->nameLength &&
+			    memcmp(world->namePool + other->nameOffset, world->namePool + room->nameOffset, room->nameLength) == 0) {
+				break;
+			}
+		}
+		if (world->nameIndex[slot] == -1) {
+			world->nameIndex[slot] = i;
+		}
+	}
+}
+
+/******************************************************************************
+ * Function Name: findRoom
+ * Description: Returns the index of the room with the given name, or -1 if no
+ *   room has that name. The name need not be null terminated.
+ *****************************************************************************/
+int findRoom(const struct World *world, const char *name, int length) {
+	unsigned int hash = hashRoomName(name, length);
+	int mask = world->nameIndexSize - 1,
+		slot,
+		roomIndex;
+
+	if (world->nameIndexSize == 0) {
+		return -1;
+	}
+	// probe from the hash until the name or an empty slot is found
+	for (slot = hash & mask; (roomIndex = world->nameIndex[slot]) != -1; slot = (slot + 1) & mask) {
+		const struct Room *room = &world->roomList[roomIndex];
+		if (room->nameHash == hash && room->nameLength == length &&
+		    memcmp(world->namePool + room->nameOffset, name, length) == 0) {
+			return roomIndex;
+		}
+	}
+	return -1;
+}
+
+/******************************************************************************
+ * Function Name: isConnected
+ * Description: Returns 1 if the first room lists the second room among its
+ *   connections, otherwise 0.
+ *****************************************************************************/
+int isConnected(const struct World *world, int fromRoom, int toRoom) {
+	const int *conns = getConns(world, fromRoom);
+	int i = 0;
+
+	for (i = 0; i < getNumConns(world, fromRoom); i++) {
+		if (conns[i] == toRoom) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// representative of a room's region, halving the path to it along the way
+static int findRegion(int *parent, int room) {
+	while (parent[room] != room) {
+		parent[room] = parent[parent[room]];
+		room = parent[room];
+	}
+	return room;
+}
+
+/******************************************************************************
+ * Function Name: countWorldRegions
+ * Description: Returns the number of separate regions of the world, where
+ *   every room of a region can reach every other room of it. Connections
+ *   are merged with a union-find over room indices, union by size and path
+ *   halving, so the count takes close to linear time. A world where every
+ *   room is reachable has exactly one region.
+ *****************************************************************************/
+int countWorldRegions(const struct World *world) {
+	int *parent = malloc(sizeof(int) * world->numRooms),
+		*size = malloc(sizeof(int) * world->numRooms),
+		numRegions = world->numRooms,
+		first,
+		second,
+		i = 0,
+		j = 0;
+
+	if (parent == NULL || size == NULL) {
+		fprintf(stderr, "Could not allocate regions for %d rooms.\n", world->numRooms);
+		exit(1);
+	}
+	for (i = 0; i < world->numRooms; i++) {
+		parent[i] = i;
+		size[i] = 1;
+	}
+	// merge the regions at both ends of every connection
+	for (i = 0; i < world->numRooms; i++) {
+		const int *conns = getConns(world, i);
+		for (j = 0; j < getNumConns(world, i); j++) {
+			first = findRegion(parent, i);
+			second = findRegion(parent, conns[j]);
+			if (first != second) {
+				if (size[first] < size[second]) {
+					int swap = first;
+					first = second;
+					second = swap;
+				}
+				parent[second] = first;
+				size[first] += size[second];
+				numRegions--;
+			}
+		}
+	}
+	free(parent);
+	free(size);
+	return numRegions;
+}
+
+// mix a run of bytes into a 64 bit FNV-1a hash
+static unsigned long long hashBytes(unsigned long long hash, const void *data, size_t length) {
+	const unsigned char *bytes = data;
+	size_t i = 0;
+
+	for (i = 0; i < length; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/******************************************************************************
+ * Function Name: hashWorld
+ * Description: Returns a 64 bit FNV-1a fingerprint of everything that makes a
+ *   world what it is: start and end rooms, every room's type and name, and
+ *   every connection in order. Two worlds with the same fingerprint were, in
+ *   practice, generated identically.
+ *****************************************************************************/
+unsigned long long hashWorld(const struct World *world) {
+	unsigned long long hash = 14695981039346656037ULL;
+	int header[3] = { world->numRooms, world->startRoomIndex, world->endRoomIndex },
+		i = 0;
+
+	hash = hashBytes(hash, header, sizeof(header));
+	for (i = 0; i < world->numRooms; i++) {
+		hash = hashBytes(hash, &world->roomList[i].type, sizeof(int));
+		hash = hashBytes(hash, getRoomName(world, i), world->roomList[i].nameLength + 1);
+	}
+	hash = hashBytes(hash, world->connOffsets, sizeof(int) * ((size_t)world->numRooms + 1));
+	hash = hashBytes(hash, world->connList, sizeof(int) * (size_t)world->numConns);
+	return hash;
+}
+
+/******************************************************************************
+ * Function Name: getRoomTypeName
+ * Description: Returns the text label written to room files for a room type.
+ *****************************************************************************/
+const char *getRoomTypeName(int type) {
+	if (type < MID_ROOM || type > END_ROOM) {
+		return "UNKNOWN";
+	}
+	return roomTypeNames[type];
+}
+
+/******************************************************************************
+ * Function Name: parseRoomType
+ * Description: Returns the room type for a text label from a room file, or -1
+ *   if the label is not recognized.
+ *****************************************************************************/
+int parseRoomType(const char *typeName) {
+	int i = 0;
+
+	for (i = MID_ROOM; i <= END_ROOM; i++) {
+		if (strcmp(typeName, roomTypeNames[i]) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/******************************************************************************
+ * Function Name: initWorldBuilder
+ * Description: Allocate a builder able to hold up to maxConn connections for
+ *   each of the specified number of rooms, from an arena if one is given.
+ *****************************************************************************/
+void initWorldBuilder(struct WorldBuilder *builder, int numRooms, int maxConn, struct Arena *arena) {
+	builder->numRooms = numRooms;
+	builder->maxConn = maxConn;
+	builder->arena = arena;
+	builder->numConn = allocWorldMemory(arena, sizeof(int) * numRooms);
+	builder->conns = allocWorldMemory(arena, sizeof(int) * (size_t)numRooms * (maxConn > 0 ? maxConn : 1));
+	builder->openRooms = allocWorldMemory(arena, sizeof(int) * numRooms);
+	builder->openPosition = allocWorldMemory(arena, sizeof(int) * numRooms);
+	if (builder->numConn == NULL || builder->conns == NULL ||
+	    builder->openRooms == NULL || builder->openPosition == NULL) {
+		fprintf(stderr, "Could not allocate connections for %d rooms.\n", numRooms);
+		exit(1);
+	}
+	// small worlds also keep their connections as bits
+	initRoomMatrix(&builder->matrix, numRooms, arena);
+	clearWorldBuilder(builder);
+}
+
+/******************************************************************************
+ * Function Name: freeWorldBuilder
+ * Description: Release all memory held by a builder.
+ *****************************************************************************/
+void freeWorldBuilder(struct WorldBuilder *builder) {
+	if (builder->arena == NULL) {
+		free(builder->numConn);
+		free(builder->conns);
+		free(builder->openRooms);
+		free(builder->openPosition);
+	}
+	freeRoomMatrix(&builder->matrix);
+	builder->numConn = NULL;
+	builder->conns = NULL;
+	builder->openRooms = NULL;
+	builder->openPosition = NULL;
+}
+
+/******************************************************************************
+ * Function Name: clearWorldBuilder
+ * Description: Remove every connection from a builder so it can be refilled.
+ *   Every room has free slots again, so every room is open.
+ *****************************************************************************/
+void clearWorldBuilder(struct WorldBuilder *builder) {
+	int i = 0;
+
+	memset(builder->numConn, 0, sizeof(int) * builder->numRooms);
+	if (builder->matrix.rows != NULL) {
+		clearRoomMatrix(&builder->matrix);
+	}
+	builder->numOpen = 0;
+	for (i = 0; i < builder->numRooms; i++) {
+		builder->openPosition[i] = -1;
+		if (builder->maxConn > 0) {
+			builder->openPosition[i] = builder->numOpen;
+			builder->openRooms[builder->numOpen++] = i;
+		}
+	}
+}
+
+/******************************************************************************
+ * Function Name: hasBuilderConn
+ * Description: Returns 1 if the first room already lists the second room as
+ *   one of its connections, otherwise 0. Small worlds test one bit of the
+ *   room matrix instead of scanning the room's slots.
+ *****************************************************************************/
+int hasBuilderConn(struct WorldBuilder *builder, int fromRoom, int toRoom) {
+	int *slots = builder->conns + (size_t)fromRoom * builder->maxConn;
+	int i = 0;
+
+	if (builder->matrix.rows != NULL) {
+		return hasMatrixConn(&builder->matrix, fromRoom, toRoom);
+	}
+
+	for (i = 0; i < builder->numConn[fromRoom]; i++) {
+		if (slots[i] == toRoom) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: addBuilderConn
+ * Description: Record a one-way connection from one room to another. Returns
+ *   1 on success, or 0 if the room has no free slots, already lists the other
+ *   room, or the connection would lead back to itself. A room that fills its
+ *   last slot is swapped out of the open room list.
+ *****************************************************************************/
+int addBuilderConn(struct WorldBuilder *builder, int fromRoom, int toRoom) {
+	int position,
+		lastRoom;
+
+	if (fromRoom == toRoom ||
+	    builder->numConn[fromRoom] >= builder->maxConn ||
+	    hasBuilderConn(builder, fromRoom, toRoom)) {
+		return 0;
+	}
+	builder->conns[(size_t)fromRoom * builder->maxConn + builder->numConn[fromRoom]] = toRoom;
+	builder->numConn[fromRoom]++;
+	if (builder->matrix.rows != NULL) {
+		setMatrixConn(&builder->matrix, fromRoom, toRoom);
+	}
+
+	// close the room once its slots are full
+	if (builder->numConn[fromRoom] == builder->maxConn) {
+		position = builder->openPosition[fromRoom];
+		lastRoom = builder->openRooms[--builder->numOpen];
+		builder->openRooms[position] = lastRoom;
+		builder->openPosition[lastRoom] = position;
+		builder->openPosition[fromRoom] = -1;
+	}
+	return 1;
+}
+
+/******************************************************************************
+ * Function Name: linkBuilderRooms
+ * Description: Record a connection in both directions. Returns 1 on success,
+ *   or 0, with nothing recorded, if either room would refuse its half.
+ *****************************************************************************/
+int linkBuilderRooms(struct WorldBuilder *builder, int firstRoom, int secondRoom) {
+	if (firstRoom == secondRoom ||
+	    builder->numConn[firstRoom] >= builder->maxConn ||
+	    builder->numConn[secondRoom] >= builder->maxConn ||
+	    hasBuilderConn(builder, firstRoom, secondRoom)) {
+		return 0;
+	}
+	addBuilderConn(builder, firstRoom, secondRoom);
+	addBuilderConn(builder, secondRoom, firstRoom);
+	return 1;
+}
+
+/******************************************************************************
+ * Function Name: replaceBuilderConn
+ * Description: Point one of a room's connections at another room in place,
+ *   keeping its slot, so the room's degree and its place in the open room
+ *   list stay the same. Only this direction changes; the caller rewires the
+ *   other rooms. Returns 1 on success, or 0 if the room does not list the
+ *   old room, already lists the new one, or the new one is itself.
+ *****************************************************************************/
+int replaceBuilderConn(struct WorldBuilder *builder, int fromRoom, int oldRoom, int newRoom) {
+	int *slots = builder->conns + (size_t)fromRoom * builder->maxConn;
+	int i = 0;
+
+	if (fromRoom == newRoom || hasBuilderConn(builder, fromRoom, newRoom)) {
+		return 0;
+	}
+	for (i = 0; i < builder->numConn[fromRoom]; i++) {
+		if (slots[i] == oldRoom) {
+			slots[i] = newRoom;
+			if (builder->matrix.rows != NULL) {
+				clearMatrixConn(&builder->matrix, fromRoom, oldRoom);
+				setMatrixConn(&builder->matrix, fromRoom, newRoom);
+			}
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: packRoomConns
+ * Description: Replace the world's connections with those in a table of
+ *   maxConn slots per room, numConn of them used. Offsets are computed with
+ *   a running sum of the connection counts and each room's slots are copied
+ *   into one contiguous connection list.
+ *****************************************************************************/
+void packRoomConns(struct World *world, const int *numConn, const int *conns, int maxConn) {
+	int i = 0,
+		total = 0;
+
+	// compute where each room's connections begin
+	for (i = 0; i < world->numRooms; i++) {
+		world->connOffsets[i] = total;
+		total += numConn[i];
+	}
+	world->connOffsets[world->numRooms] = total;
+
+	// copy every room's slots into the packed list
+	if (world->arena == NULL) {
+		free(world->connList);
+	}
+	world->connList = allocWorldMemory(world->arena, sizeof(int) * (total > 0 ? total : 1));
+	if (world->connList == NULL) {
+		fprintf(stderr, "Could not allocate %d connections.\n", total);
+		exit(1);
+	}
+	for (i = 0; i < world->numRooms; i++) {
+		memcpy(world->connList + world->connOffsets[i], conns + (size_t)i * maxConn,
+		       sizeof(int) * numConn[i]);
+	}
+	world->numConns = total;
+}
+
+/******************************************************************************
+ * Function Name: packWorldConns
+ * Description: Replace the world's connections with those held by the
+ *   builder.
+ *****************************************************************************/
+void packWorldConns(struct WorldBuilder *builder, struct World *world) {
+	packRoomConns(world, builder->numConn, builder->conns, builder->maxConn);
+}
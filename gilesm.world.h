@@ -0,0 +1,138 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.world.h
+ * Description: Room graph for the adventure game. A world holds a runtime
+ *   sized list of rooms and stores the connections between them in a compact
+ *   adjacency layout: every room's neighbors sit next to each other in one
+ *   shared connection list, and an offsets array marks where each room's
+ *   neighbors begin. Memory grows with the number of connections rather than
+ *   the square of the number of rooms, and listing the exits of a room costs
+ *   only as much as the room has exits.
+ *
+ *   Room names are interned: each is stored once, back to back in a single
+ *   name pool, and rooms refer to them by offset along with a precomputed
+ *   hash. A hash index of room indices maps any name to its room, so looking
+ *   up a typed or saved name costs one probe on average, and rooms refer to
+ *   each other only by index. A world contains no pointers besides its
+ *   arrays, which lets it be loaded straight from a memory-mapped world file.
+ *
+ *   Connections are collected in a world builder while a world is generated
+ *   or read from files, then packed into the world in one pass. The builder
+ *   also keeps the list of rooms that still have a free connection slot, so
+ *   a generator can pick a partner room without retrying full ones. For
+ *   worlds of up to ROOM_MATRIX_MAX_ROOMS rooms it also keeps every
+ *   connection as a bit in a room matrix, so checking for a duplicate is one
+ *   bit test and the finished graph can be checked with bitset searches.
+ *
+ *   A world and a builder can take all their arrays from an arena instead
+ *   of the heap, so a game's whole world goes away with the game's arena.
+ *****************************************************************************/
+#ifndef GILESM_WORLD_H
+#define GILESM_WORLD_H
+
+#include <stddef.h>
+#include "gilesm.arena.h"
+#include "gilesm.roommatrix.h"
+
+enum RoomType {
+	MID_ROOM = 0,						// any room between start and end
+	START_ROOM = 1,						// room the player begins in
+	END_ROOM = 2						// room the player is looking for
+};
+
+struct Room {
+	int nameOffset;						// start of name in the name pool
+	int nameLength;						// characters in name, no terminator
+	unsigned int nameHash;				// hashRoomName of the name
+	int type;							// START_ROOM, END_ROOM, MID_ROOM
+};
+
+struct World {
+	int numRooms;						// number of rooms in the world
+	int numConns;						// total entries in connList
+	int startRoomIndex;					// room list index of starting room
+	int endRoomIndex;					// room list index of ending room
+	int namePoolSize;					// bytes used in namePool
+	int namePoolCapacity;				// bytes allocated for namePool
+	int nameIndexSize;					// slots in nameIndex, a power of 2
+	struct Room *roomList;				// room information, numRooms entries
+	int *connOffsets;					// start of each room's connections
+	int *connList;						// connected room indices, by room
+	char *namePool;						// null terminated room names
+	int *nameIndex;						// room index by name hash, -1 empty
+	void *mapAddress;					// mapped world file, NULL if owned
+	size_t mapLength;					// length of the mapped world file
+	struct Arena *arena;				// arena holding the arrays, NULL for the heap
+};
+
+struct WorldBuilder {
+	int numRooms;						// number of rooms being connected
+	int maxConn;						// most connections a room may have
+	int *numConn;						// current connection count per room
+	int *conns;							// maxConn connection slots per room
+	int numOpen;						// rooms with a free connection slot
+	int *openRooms;						// the numOpen rooms with a free slot
+	int *openPosition;					// index in openRooms per room, or -1
+	struct RoomMatrix matrix;			// connection bits, rows NULL for large worlds
+	struct Arena *arena;				// arena holding the arrays, NULL for the heap
+};
+
+// allocate a world with the specified number of rooms and no connections,
+// from an arena or, if it is NULL, the heap
+void initWorld(struct World *world, int numRooms, struct Arena *arena);
+// release all memory held by a world
+void freeWorld(struct World *world);
+// copy a name into the name pool and assign it to the specified room
+void setRoomName(struct World *world, int roomIndex, const char *name);
+// hash of a room name, used by the name index
+unsigned int hashRoomName(const char *name, int length);
+// build the name index once every room has been named
+void indexRoomNames(struct World *world);
+// room index with the given name, or -1 if no room has that name
+int findRoom(const struct World *world, const char *name, int length);
+// returns 1 if the first room has a connection to the second room
+int isConnected(const struct World *world, int fromRoom, int toRoom);
+// number of separate groups of rooms that can reach each other
+int countWorldRegions(const struct World *world);
+// fingerprint of a world's rooms, names, and connections
+unsigned long long hashWorld(const struct World *world);
+// text label for a room type, e.g. START_ROOM
+const char *getRoomTypeName(int type);
+// room type for a text label, or -1 if the label is unknown
+int parseRoomType(const char *typeName);
+// allocate a builder for the specified room count and connection limit,
+// from an arena or, if it is NULL, the heap
+void initWorldBuilder(struct WorldBuilder *builder, int numRooms, int maxConn, struct Arena *arena);
+// release all memory held by a builder
+void freeWorldBuilder(struct WorldBuilder *builder);
+// remove every connection from a builder
+void clearWorldBuilder(struct WorldBuilder *builder);
+// returns 1 if the first room lists the second room as a connection
+int hasBuilderConn(struct WorldBuilder *builder, int fromRoom, int toRoom);
+// record a one-way connection, returns 0 if full, duplicate, or to itself
+int addBuilderConn(struct WorldBuilder *builder, int fromRoom, int toRoom);
+// record a two-way connection, returns 0 if either direction is refused
+int linkBuilderRooms(struct WorldBuilder *builder, int firstRoom, int secondRoom);
+// point one of a room's connections at another room, returns 0 if it cannot
+int replaceBuilderConn(struct WorldBuilder *builder, int fromRoom, int oldRoom, int newRoom);
+// copy a table of maxConn connection slots per room into the world's packed connection list
+void packRoomConns(struct World *world, const int *numConn, const int *conns, int maxConn);
+// copy the builder connections into the world's packed connection list
+void packWorldConns(struct WorldBuilder *builder, struct World *world);
+
+// name of the specified room
+static inline const char *getRoomName(const struct World *world, int roomIndex) {
+	return world->namePool + world->roomList[roomIndex].nameOffset;
+}
+
+// number of connections leaving the specified room
+static inline int getNumConns(const struct World *world, int roomIndex) {
+	return world->connOffsets[roomIndex + 1] - world->connOffsets[roomIndex];
+}
+
+// first entry of the specified room's connections in the connection list
+static inline const int *getConns(const struct World *world, int roomIndex) {
+	return world->connList + world->connOffsets[roomIndex];
+}
+
+#endif
@@ -0,0 +1,368 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.worldfile.c
+ * Description: Writing and memory-mapped loading of the binary world file
+ *   described in gilesm.worldfile.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "gilesm.worldfile.h"
+#include "gilesm.stats.h"
+
+// the file stores int arrays as 32 bit values
+typedef char worldFileIntCheck[sizeof(int) == sizeof(int32_t) ? 1 : -1];
+
+// round a file offset up to the next 8 byte boundary
+static uint64_t alignOffset(uint64_t offset) {
+	return (offset + 7) & ~(uint64_t)7;
+}
+
+/******************************************************************************
+ * Function Name: writeFileParts
+ * Description: Write the gathered parts of a file to a temporary file with as
+ *   few writev calls as the kernel allows, then rename it over the
+ *   destination so readers never see a partial file. The parts are consumed
+ *   as they are written, and the calls and bytes are counted under the kind
+ *   of file. Returns 0 on success or -1.
+ *****************************************************************************/
+static int writeFileParts(const char *fileName, struct iovec *parts, int numParts, enum StatIoId kind) {
+	char tempName[512];
+	int partIndex = 0,
+		file_descriptor;
+	ssize_t nwritten;
+
+	// open temporary file for writing
+	snprintf(tempName, sizeof(tempName), "%s.tmp", fileName);
+	file_descriptor = open(tempName, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+	if (file_descriptor == -1) {
+		fprintf(stderr, "Could not open %s to write to file.\n", tempName);
+		return -1;
+	}
+	// write every part, resuming after any short write
+	while (partIndex < numParts) {
+		nwritten = writev(file_descriptor, parts + partIndex, numParts - partIndex);
+		countStatIo(kind, 1, nwritten > 0 ? nwritten : 0);
+		if (nwritten < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "Could not write %s: %s\n", tempName, strerror(errno));
+			close(file_descriptor);
+			unlink(tempName);
+			return -1;
+		}
+		while (partIndex < numParts && (size_t)nwritten >= parts[partIndex].iov_len) {
+			nwritten -= parts[partIndex].iov_len;
+			partIndex++;
+		}
+		if (partIndex < numParts) {
+			parts[partIndex].iov_base = (char *)parts[partIndex].iov_base + nwritten;
+			parts[partIndex].iov_len -= nwritten;
+		}
+	}
+	close(file_descriptor);
+	// open, close, and rename
+	countStatIo(kind, 3, 0);
+	// replace the destination only once the file is complete
+	if (rename(tempName, fileName) == -1) {
+		fprintf(stderr, "Could not rename %s to %s.\n", tempName, fileName);
+		unlink(tempName);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: layoutWorldFile
+ * Description: Fill in the header of a world's file image and gather the
+ *   header, every section, and the padding between them in file order, so
+ *   the image can be written or copied without building it in memory. The
+ *   parts array needs room for WORLD_FILE_PARTS entries and points into
+ *   the header and the world, which must outlive it. Returns the number of
+ *   parts.
+ *****************************************************************************/
+int layoutWorldFile(const struct World *world, struct WorldFileHeader *header, struct iovec *parts) {
+	static const char padding[8] = { 0 };
+	uint64_t offset = 0;
+	int numParts = 0,
+		partIndex = 0;
+
+	// lay out each section after the header on an 8 byte boundary
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, WORLD_FILE_MAGIC, sizeof(header->magic));
+	header->version = WORLD_FILE_VERSION;
+	header->byteOrder = WORLD_FILE_BYTE_ORDER;
+	header->headerSize = sizeof(*header);
+	header->roomSize = sizeof(struct Room);
+	header->numRooms = world->numRooms;
+	header->numConns = world->numConns;
+	header->startRoomIndex = world->startRoomIndex;
+	header->endRoomIndex = world->endRoomIndex;
+	header->namePoolSize = world->namePoolSize;
+	header->nameIndexSize = world->nameIndexSize;
+	header->roomTableOffset = alignOffset(sizeof(*header));
+	header->connOffsetsOffset = alignOffset(header->roomTableOffset + sizeof(struct Room) * (uint64_t)world->numRooms);
+	header->connListOffset = alignOffset(header->connOffsetsOffset + sizeof(int) * ((uint64_t)world->numRooms + 1));
+	header->nameIndexOffset = alignOffset(header->connListOffset + sizeof(int) * (uint64_t)world->numConns);
+	header->namePoolOffset = alignOffset(header->nameIndexOffset + sizeof(int) * (uint64_t)world->nameIndexSize);
+	header->fileSize = header->namePoolOffset + world->namePoolSize;
+
+	// gather the header, sections, and padding in file order
+	parts[numParts].iov_base = header;
+	parts[numParts++].iov_len = sizeof(*header);
+	offset = sizeof(*header);
+	{
+		const void *bases[5] = { world->roomList, world->connOffsets, world->connList,
+		                         world->nameIndex, world->namePool };
+		uint64_t starts[5] = { header->roomTableOffset, header->connOffsetsOffset, header->connListOffset,
+		                       header->nameIndexOffset, header->namePoolOffset };
+		uint64_t lengths[5] = { sizeof(struct Room) * (uint64_t)world->numRooms,
+		                        sizeof(int) * ((uint64_t)world->numRooms + 1),
+		                        sizeof(int) * (uint64_t)world->numConns,
+		                        sizeof(int) * (uint64_t)world->nameIndexSize,
+		                        (uint64_t)world->namePoolSize };
+		for (partIndex = 0; partIndex < 5; partIndex++) {
+			if (starts[partIndex] > offset) {
+				parts[numParts].iov_base = (void *)padding;
+				parts[numParts++].iov_len = starts[partIndex] - offset;
+			}
+			parts[numParts].iov_base = (void *)bases[partIndex];
+			parts[numParts++].iov_len = lengths[partIndex];
+			offset = starts[partIndex] + lengths[partIndex];
+		}
+	}
+	return numParts;
+}
+
+/******************************************************************************
+ * Function Name: writeWorldFile
+ * Description: Write the world to a binary world file. The header, padding,
+ *   and every section are gathered into one writev call on a temporary file,
+ *   which is renamed over the destination once complete so readers never map
+ *   a partly written world. Returns 0 on success or -1 on failure.
+ *****************************************************************************/
+int writeWorldFile(const struct World *world, const char *fileName) {
+	struct WorldFileHeader header;
+	struct iovec parts[WORLD_FILE_PARTS];
+	int numParts = layoutWorldFile(world, &header, parts),
+		result;
+	uint64_t start = startStatTimer();
+
+	result = writeFileParts(fileName, parts, numParts, STAT_IO_WORLD_FILE);
+	stopStatTimer(STAT_WRITE_WORLD_FILE, start);
+	return result;
+}
+
+/******************************************************************************
+ * Function Name: checkWorldHeader
+ * Description: Check that a world file header was written by this build and
+ *   that every section it describes lies inside an image of the specified
+ *   length, explaining any problem on stderr. The source name is only used
+ *   in messages. Returns 0 if the header can be used or -1.
+ *****************************************************************************/
+int checkWorldHeader(const struct WorldFileHeader *header, uint64_t length, const char *sourceName) {
+	// reject images from another format, build, or byte order
+	if (memcmp(header->magic, WORLD_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->version != WORLD_FILE_VERSION ||
+	    header->byteOrder != WORLD_FILE_BYTE_ORDER ||
+	    header->headerSize != sizeof(*header) ||
+	    header->roomSize != sizeof(struct Room)) {
+		fprintf(stderr, "%s is not a version %d world.\n", sourceName, WORLD_FILE_VERSION);
+		return -1;
+	}
+	// reject headers whose sections do not fit inside the image
+	if (header->fileSize != length ||
+	    header->numRooms < 1 || header->numConns < 0 || header->namePoolSize < 1 ||
+	    header->nameIndexSize <= header->numRooms || (header->nameIndexSize & (header->nameIndexSize - 1)) != 0 ||
+	    header->startRoomIndex < 0 || header->startRoomIndex >= header->numRooms ||
+	    header->endRoomIndex < 0 || header->endRoomIndex >= header->numRooms ||
+	    header->roomTableOffset + sizeof(struct Room) * (uint64_t)header->numRooms > header->connOffsetsOffset ||
+	    header->connOffsetsOffset + sizeof(int) * ((uint64_t)header->numRooms + 1) > header->connListOffset ||
+	    header->connListOffset + sizeof(int) * (uint64_t)header->numConns > header->nameIndexOffset ||
+	    header->nameIndexOffset + sizeof(int) * (uint64_t)header->nameIndexSize > header->namePoolOffset ||
+	    header->namePoolOffset + header->namePoolSize > header->fileSize ||
+	    (header->roomTableOffset | header->connOffsetsOffset | header->connListOffset | header->nameIndexOffset) % 8 != 0) {
+		fprintf(stderr, "%s has a damaged world header.\n", sourceName);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: checkWorldSections
+ * Description: Check every index a world file image's sections hold, with
+ *   the same ranges readFileRoom checks room by room: connection offsets
+ *   that start at 0, never decrease, and end at the connection count,
+ *   connections to rooms that exist, names that lie inside the name pool
+ *   with their terminator, and name index slots that are empty or hold a
+ *   room, with at least one empty so every lookup ends. The header must
+ *   already have passed checkWorldHeader. Returns 0 if the sections can be
+ *   used or -1.
+ *****************************************************************************/
+static int checkWorldSections(const struct WorldFileHeader *header, const char *base, const char *sourceName) {
+	const struct Room *roomList = (const struct Room *)(base + header->roomTableOffset);
+	const int *connOffsets = (const int *)(base + header->connOffsetsOffset),
+			  *connList = (const int *)(base + header->connListOffset),
+			  *nameIndex = (const int *)(base + header->nameIndexOffset);
+	const char *namePool = base + header->namePoolOffset;
+	int numEmpty = 0,
+		i = 0;
+
+	if (connOffsets[0] != 0 || connOffsets[header->numRooms] != header->numConns) {
+		fprintf(stderr, "%s has damaged connection offsets.\n", sourceName);
+		return -1;
+	}
+	for (i = 0; i < header->numRooms; i++) {
+		if (connOffsets[i + 1] < connOffsets[i]) {
+			fprintf(stderr, "%s has damaged connection offsets.\n", sourceName);
+			return -1;
+		}
+		if (roomList[i].nameOffset < 0 || roomList[i].nameLength < 0 ||
+		    (int64_t)roomList[i].nameOffset + roomList[i].nameLength >= header->namePoolSize ||
+		    namePool[roomList[i].nameOffset + roomList[i].nameLength] != '\0') {
+			fprintf(stderr, "%s has a damaged name pool.\n", sourceName);
+			return -1;
+		}
+	}
+	for (i = 0; i < header->numConns; i++) {
+		if (connList[i] < 0 || connList[i] >= header->numRooms) {
+			fprintf(stderr, "%s has a damaged connection list.\n", sourceName);
+			return -1;
+		}
+	}
+	// a lookup of an unknown name only stops at an empty slot
+	for (i = 0; i < header->nameIndexSize; i++) {
+		if (nameIndex[i] < -1 || nameIndex[i] >= header->numRooms) {
+			fprintf(stderr, "%s has a damaged name index.\n", sourceName);
+			return -1;
+		}
+		numEmpty += nameIndex[i] == -1;
+	}
+	if (numEmpty == 0) {
+		fprintf(stderr, "%s has a damaged name index.\n", sourceName);
+		return -1;
+	}
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: useWorldImage
+ * Description: Point a world's arrays directly into a world file image that
+ *   is already in memory, such as a mapped file. The header is checked with
+ *   checkWorldHeader and every index in the sections with
+ *   checkWorldSections, once, so nothing read from the image later can
+ *   reach outside it. The source name is only used in messages. The caller
+ *   keeps the image alive and records how to release it. Returns 0 on
+ *   success or -1 if the image cannot be used.
+ *****************************************************************************/
+int useWorldImage(struct World *world, const char *base, size_t length, const char *sourceName) {
+	const struct WorldFileHeader *header = (const struct WorldFileHeader *)base;
+
+	if (length < sizeof(*header)) {
+		fprintf(stderr, "%s is too short to be a world.\n", sourceName);
+		return -1;
+	}
+	if (checkWorldHeader(header, length, sourceName) == -1 ||
+	    checkWorldSections(header, base, sourceName) == -1) {
+		return -1;
+	}
+
+	// point the world into the image
+	world->numRooms = header->numRooms;
+	world->numConns = header->numConns;
+	world->startRoomIndex = header->startRoomIndex;
+	world->endRoomIndex = header->endRoomIndex;
+	world->namePoolSize = header->namePoolSize;
+	world->namePoolCapacity = 0;
+	world->nameIndexSize = header->nameIndexSize;
+	world->roomList = (struct Room *)((char *)base + header->roomTableOffset);
+	world->connOffsets = (int *)((char *)base + header->connOffsetsOffset);
+	world->connList = (int *)((char *)base + header->connListOffset);
+	world->nameIndex = (int *)((char *)base + header->nameIndexOffset);
+	world->namePool = (char *)base + header->namePoolOffset;
+	world->arena = NULL;
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: loadWorldFile
+ * Description: Map a binary world file read-only and point the world's arrays
+ *   directly into the mapping with useWorldImage. Returns 0 on success or -1
+ *   if the file cannot be used.
+ *****************************************************************************/
+int loadWorldFile(struct World *world, const char *fileName) {
+	struct stat fileInfo;
+	char *base;
+	int file_descriptor;
+	uint64_t start = startStatTimer();
+
+	// open the file and map its full length
+	file_descriptor = open(fileName, O_RDONLY);
+	if (file_descriptor == -1) {
+		fprintf(stderr, "Could not open %s to read the world.\n", fileName);
+		return -1;
+	}
+	if (fstat(file_descriptor, &fileInfo) == -1 || (size_t)fileInfo.st_size < sizeof(struct WorldFileHeader)) {
+		fprintf(stderr, "%s is too short to be a world file.\n", fileName);
+		close(file_descriptor);
+		return -1;
+	}
+	base = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+	close(file_descriptor);
+	// open, fstat, mmap, and close; the pages are read as they are touched
+	countStatIo(STAT_IO_WORLD_FILE, 4, fileInfo.st_size);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "Could not map %s: %s\n", fileName, strerror(errno));
+		return -1;
+	}
+	if (useWorldImage(world, base, fileInfo.st_size, fileName) == -1) {
+		munmap(base, fileInfo.st_size);
+		return -1;
+	}
+	world->mapAddress = base;
+	world->mapLength = fileInfo.st_size;
+	stopStatTimer(STAT_LOAD_WORLD_FILE, start);
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: writeStepTrace
+ * Description: Write the rooms a player moved through to a binary step trace
+ *   in one gathered write: the header, then one 32 bit room index per step.
+ *   The header records the world's fingerprint so a trace can be matched to
+ *   the world it was played in. Returns 0 on success or -1.
+ *****************************************************************************/
+int writeStepTrace(const struct World *world, uint64_t seed, const int *stepList, int numSteps,
+                   const char *fileName) {
+	struct StepTraceHeader header;
+	struct iovec parts[2];
+	uint64_t start = startStatTimer();
+	int result;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, STEP_TRACE_MAGIC, sizeof(header.magic));
+	header.version = STEP_TRACE_VERSION;
+	header.byteOrder = WORLD_FILE_BYTE_ORDER;
+	header.headerSize = sizeof(header);
+	header.numSteps = numSteps;
+	header.startRoomIndex = world->startRoomIndex;
+	header.endRoomIndex = world->endRoomIndex;
+	header.seed = seed;
+	header.worldHash = hashWorld(world);
+
+	parts[0].iov_base = &header;
+	parts[0].iov_len = sizeof(header);
+	parts[1].iov_base = (void *)stepList;
+	parts[1].iov_len = sizeof(int) * (size_t)numSteps;
+	result = writeFileParts(fileName, parts, numSteps > 0 ? 2 : 1, STAT_IO_STEP_TRACE);
+	stopStatTimer(STAT_WRITE_STEP_TRACE, start);
+	return result;
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.worldfile.h
+ * Description: Single file binary format for a whole world. The file holds a
+ *   fixed header followed by the room table, the connection offsets, the
+ *   connection list, the name index, and the name pool, each starting on an 8
+ *   byte boundary. Every section is stored exactly as the world keeps it in
+ *   memory, so a world file is written with one gathered write and opened
+ *   with one mmap call and a range check of its indices, with no parsing.
+ *
+ *   A step trace records one played game in the same spirit: a fixed header
+ *   naming the world, followed by the index of every room the player moved
+ *   to, in order.
+ *****************************************************************************/
+#ifndef GILESM_WORLDFILE_H
+#define GILESM_WORLDFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "gilesm.world.h"
+
+#define WORLD_FILE_MAGIC "GADVWRLD"			// first 8 bytes of every world file
+#define WORLD_FILE_VERSION 2				// bumped whenever the layout changes
+#define WORLD_FILE_BYTE_ORDER 0x01020304	// reads differently on other endians
+#define WORLD_FILE_PARTS 11					// header, sections, and padding
+
+struct WorldFileHeader {
+	char magic[8];						// WORLD_FILE_MAGIC, not terminated
+	uint32_t version;					// WORLD_FILE_VERSION
+	uint32_t byteOrder;					// WORLD_FILE_BYTE_ORDER
+	uint32_t headerSize;				// sizeof(struct WorldFileHeader)
+	uint32_t roomSize;					// sizeof(struct Room)
+	int32_t numRooms;					// number of rooms in the room table
+	int32_t numConns;					// number of entries in connection list
+	int32_t startRoomIndex;				// room list index of starting room
+	int32_t endRoomIndex;				// room list index of ending room
+	int32_t namePoolSize;				// bytes in the name pool
+	int32_t nameIndexSize;				// slots in the name index
+	uint64_t roomTableOffset;			// file offset of the room table
+	uint64_t connOffsetsOffset;			// file offset of connection offsets
+	uint64_t connListOffset;			// file offset of connection list
+	uint64_t nameIndexOffset;			// file offset of the name index
+	uint64_t namePoolOffset;			// file offset of the name pool
+	uint64_t fileSize;					// total bytes in the file
+};
+
+#define STEP_TRACE_MAGIC "GADVSTEP"			// first 8 bytes of every step trace
+#define STEP_TRACE_VERSION 1				// bumped whenever the layout changes
+
+struct StepTraceHeader {
+	char magic[8];						// STEP_TRACE_MAGIC, not terminated
+	uint32_t version;					// STEP_TRACE_VERSION
+	uint32_t byteOrder;					// WORLD_FILE_BYTE_ORDER
+	uint32_t headerSize;				// sizeof(struct StepTraceHeader)
+	int32_t numSteps;					// room indices following the header
+	int32_t startRoomIndex;				// room the game started in
+	int32_t endRoomIndex;				// room the game ended in
+	uint64_t seed;						// seed the world was generated from
+	uint64_t worldHash;					// hashWorld of the world played
+};
+
+// fill in a world file header and gather the file's parts, returns their number
+int layoutWorldFile(const struct World *world, struct WorldFileHeader *header, struct iovec *parts);
+// write a world to a binary world file, returns 0 on success or -1
+int writeWorldFile(const struct World *world, const char *fileName);
+// check a world file header against an image length, returns 0 if usable or -1
+int checkWorldHeader(const struct WorldFileHeader *header, uint64_t length, const char *sourceName);
+// point a world into a world file image in memory, returns 0 on success or -1
+int useWorldImage(struct World *world, const char *base, size_t length, const char *sourceName);
+// map a binary world file read-only into a world, returns 0 on success or -1
+int loadWorldFile(struct World *world, const char *fileName);
+// write the rooms of a played game to a step trace, returns 0 on success or -1
+int writeStepTrace(const struct World *world, uint64_t seed, const int *stepList, int numSteps,
+                   const char *fileName);
+
+#endif
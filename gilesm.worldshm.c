@@ -0,0 +1,214 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.worldshm.c
+ * Description: Shared memory worlds described in gilesm.worldshm.h.
+ *****************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "gilesm.worldfile.h"
+#include "gilesm.worldshm.h"
+
+// the image starts on a cache line so its sections keep their alignment
+#define WORLD_SHM_IMAGE_OFFSET 64
+
+typedef char worldShmHeaderCheck[sizeof(struct WorldShmHeader) <= WORLD_SHM_IMAGE_OFFSET ? 1 : -1];
+
+/******************************************************************************
+ * Function Name: claimAbandonedWorld
+ * Description: Take over an existing shared world if it was abandoned: it is
+ *   fully sized and names an owner, and that owner retired it or no longer
+ *   exists. An object not yet sized, or sized but with no owner written yet,
+ *   is a world another publisher is still creating and is never taken. The
+ *   claim swaps this process in as owner with one compare and swap, so when
+ *   several publishers find the same abandoned world only one wins, and it
+ *   marks the world retired so nothing attaches to it. Returns 1 if this
+ *   process now owns the name and may remove it, otherwise 0.
+ *****************************************************************************/
+static int claimAbandonedWorld(int file_descriptor) {
+	struct WorldShmHeader *header;
+	struct stat objectInfo;
+	int32_t owner;
+	int claimed = 0;
+
+	if (fstat(file_descriptor, &objectInfo) == -1 || (size_t)objectInfo.st_size < WORLD_SHM_IMAGE_OFFSET) {
+		return 0;
+	}
+	header = mmap(NULL, sizeof(*header), PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+	if (header == MAP_FAILED) {
+		return 0;
+	}
+	owner = __atomic_load_n(&header->ownerProcess, __ATOMIC_ACQUIRE);
+	if (owner > 0 &&
+	    (__atomic_load_n(&header->state, __ATOMIC_ACQUIRE) == WORLD_SHM_RETIRED ||
+	     (kill(owner, 0) == -1 && errno == ESRCH)) &&
+	    __atomic_compare_exchange_n(&header->ownerProcess, &owner, (int32_t)getpid(), 0,
+	                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		__atomic_store_n(&header->state, WORLD_SHM_RETIRED, __ATOMIC_RELEASE);
+		claimed = 1;
+	}
+	munmap(header, sizeof(*header));
+	return claimed;
+}
+
+/******************************************************************************
+ * Function Name: publishWorld
+ * Description: Create a shared memory object under a name and copy the world
+ *   into it as a world file image behind a WorldShmHeader. The world is
+ *   marked ready only once the copy is complete. A name already held by a
+ *   live owner, or still being created, is refused; one left by a dead or
+ *   retired owner is claimed with claimAbandonedWorld and replaced.
+ *   Returns 0 on success or -1.
+ *****************************************************************************/
+int publishWorld(const struct World *world, const char *shmName) {
+	struct WorldFileHeader fileHeader;
+	struct WorldShmHeader *header;
+	struct iovec parts[WORLD_FILE_PARTS];
+	char *base,
+		 *position;
+	size_t length;
+	int numParts = layoutWorldFile(world, &fileHeader, parts),
+		file_descriptor,
+		claimed = 0,
+		i = 0;
+
+	// create the object, taking the name over from an abandoned world
+	file_descriptor = shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if (file_descriptor == -1 && errno == EEXIST) {
+		file_descriptor = shm_open(shmName, O_RDWR, 0);
+		if (file_descriptor != -1) {
+			claimed = claimAbandonedWorld(file_descriptor);
+			close(file_descriptor);
+		}
+		if (claimed) {
+			shm_unlink(shmName);
+			file_descriptor = shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, 0644);
+		}
+		if (!claimed || (file_descriptor == -1 && errno == EEXIST)) {
+			fprintf(stderr, "%s is already published by a running process.\n", shmName);
+			return -1;
+		}
+	}
+	if (file_descriptor == -1) {
+		fprintf(stderr, "Could not create shared memory %s: %s\n", shmName, strerror(errno));
+		return -1;
+	}
+	length = WORLD_SHM_IMAGE_OFFSET + fileHeader.fileSize;
+	if (ftruncate(file_descriptor, length) == -1 ||
+	    (base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0)) == MAP_FAILED) {
+		fprintf(stderr, "Could not size shared memory %s: %s\n", shmName, strerror(errno));
+		close(file_descriptor);
+		shm_unlink(shmName);
+		return -1;
+	}
+	close(file_descriptor);
+
+	// claim the world, copy the header and image, then mark the world ready
+	header = (struct WorldShmHeader *)base;
+	__atomic_store_n(&header->ownerProcess, (int32_t)getpid(), __ATOMIC_RELEASE);
+	memcpy(header->magic, WORLD_SHM_MAGIC, sizeof(header->magic));
+	header->version = WORLD_SHM_VERSION;
+	header->headerSize = sizeof(*header);
+	header->imageOffset = WORLD_SHM_IMAGE_OFFSET;
+	header->imageSize = fileHeader.fileSize;
+	position = base + WORLD_SHM_IMAGE_OFFSET;
+	for (i = 0; i < numParts; i++) {
+		memcpy(position, parts[i].iov_base, parts[i].iov_len);
+		position += parts[i].iov_len;
+	}
+	__atomic_store_n(&header->state, WORLD_SHM_READY, __ATOMIC_RELEASE);
+	munmap(base, length);
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: attachWorld
+ * Description: Map a published world read-only and point the world's arrays
+ *   into the mapping. The world must come from this format and be marked
+ *   ready; its image is checked like a world file. Returns 0 on success or
+ *   -1 if there is no usable world under the name.
+ *****************************************************************************/
+int attachWorld(struct World *world, const char *shmName) {
+	const struct WorldShmHeader *header;
+	struct stat objectInfo;
+	char *base;
+	int file_descriptor;
+
+	file_descriptor = shm_open(shmName, O_RDONLY, 0);
+	if (file_descriptor == -1) {
+		fprintf(stderr, "No world is published as %s.\n", shmName);
+		return -1;
+	}
+	if (fstat(file_descriptor, &objectInfo) == -1 || (size_t)objectInfo.st_size < WORLD_SHM_IMAGE_OFFSET) {
+		fprintf(stderr, "%s is not ready to attach.\n", shmName);
+		close(file_descriptor);
+		return -1;
+	}
+	base = mmap(NULL, objectInfo.st_size, PROT_READ, MAP_SHARED, file_descriptor, 0);
+	close(file_descriptor);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "Could not map %s: %s\n", shmName, strerror(errno));
+		return -1;
+	}
+
+	// reject other formats and worlds that are not complete or are going away
+	header = (const struct WorldShmHeader *)base;
+	if (memcmp(header->magic, WORLD_SHM_MAGIC, sizeof(header->magic)) != 0 ||
+	    header->version != WORLD_SHM_VERSION || header->headerSize != sizeof(*header)) {
+		fprintf(stderr, "%s is not a version %d shared world.\n", shmName, WORLD_SHM_VERSION);
+		munmap(base, objectInfo.st_size);
+		return -1;
+	}
+	if (__atomic_load_n(&header->state, __ATOMIC_ACQUIRE) != WORLD_SHM_READY) {
+		fprintf(stderr, "%s is not ready to attach.\n", shmName);
+		munmap(base, objectInfo.st_size);
+		return -1;
+	}
+	if (header->imageOffset < sizeof(*header) || header->imageOffset % 8 != 0 ||
+	    header->imageOffset + header->imageSize > (uint64_t)objectInfo.st_size ||
+	    useWorldImage(world, base + header->imageOffset, header->imageSize, shmName) == -1) {
+		munmap(base, objectInfo.st_size);
+		return -1;
+	}
+	world->mapAddress = base;
+	world->mapLength = objectInfo.st_size;
+	return 0;
+}
+
+/******************************************************************************
+ * Function Name: retireWorld
+ * Description: Mark a published world retired, so processes about to attach
+ *   turn it away, then remove its name. Processes already attached keep
+ *   their mapping until they exit. Returns 0 on success or -1.
+ *****************************************************************************/
+int retireWorld(const char *shmName) {
+	struct WorldShmHeader *header;
+	struct stat objectInfo;
+	int file_descriptor;
+
+	file_descriptor = shm_open(shmName, O_RDWR, 0);
+	if (file_descriptor == -1) {
+		fprintf(stderr, "No world is published as %s.\n", shmName);
+		return -1;
+	}
+	if (fstat(file_descriptor, &objectInfo) == 0 && (size_t)objectInfo.st_size >= sizeof(*header)) {
+		header = mmap(NULL, sizeof(*header), PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+		if (header != MAP_FAILED) {
+			__atomic_store_n(&header->state, WORLD_SHM_RETIRED, __ATOMIC_RELEASE);
+			munmap(header, sizeof(*header));
+		}
+	}
+	close(file_descriptor);
+	if (shm_unlink(shmName) == -1) {
+		fprintf(stderr, "Could not remove shared memory %s: %s\n", shmName, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
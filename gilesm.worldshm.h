@@ -0,0 +1,54 @@
+/******************************************************************************
+ * Author: Mark Giles
+ * Filename: gilesm.worldshm.h
+ * Description: Worlds published in POSIX shared memory. An owner process
+ *   copies a built world into a named shared memory object once, and any
+ *   number of game processes attach to it with one read-only mapping instead
+ *   of building their own. The object holds a small header followed by the
+ *   same image as a binary world file, which refers to everything by offset,
+ *   so it can be mapped at any address.
+ *
+ *   The header says which format the image is in and whether it is ready:
+ *   a world is marked ready only after it has been copied in full, and the
+ *   owner marks it retired before removing its name. Processes already
+ *   attached keep their mapping after the name is removed, so retiring or
+ *   replacing a world never disturbs a game in progress. A name left behind
+ *   by an owner that died can be taken over by the next publisher, which
+ *   claims it by swapping its own process ID into the header, so only one
+ *   publisher ever takes it over. A name whose object is not yet sized, or
+ *   names no owner yet, belongs to a publisher still creating it and is
+ *   never taken; --unpublish removes one whose publisher died that early.
+ *****************************************************************************/
+#ifndef GILESM_WORLDSHM_H
+#define GILESM_WORLDSHM_H
+
+#include <stdint.h>
+#include "gilesm.world.h"
+
+#define WORLD_SHM_MAGIC "GADVSHMW"			// first 8 bytes of every shared world
+#define WORLD_SHM_VERSION 1					// bumped whenever the header changes
+
+enum WorldShmState {
+	WORLD_SHM_BUILDING = 0,				// the owner is still copying the world
+	WORLD_SHM_READY = 1,				// the world is complete and never changes
+	WORLD_SHM_RETIRED = 2				// the owner is removing the world
+};
+
+struct WorldShmHeader {
+	char magic[8];						// WORLD_SHM_MAGIC, not terminated
+	uint32_t version;					// WORLD_SHM_VERSION
+	uint32_t state;						// enum WorldShmState
+	int32_t ownerProcess;				// process ID of the publisher
+	uint32_t headerSize;				// sizeof(struct WorldShmHeader)
+	uint64_t imageOffset;				// offset of the world file image
+	uint64_t imageSize;					// bytes in the world file image
+};
+
+// copy a world into shared memory under a name, returns 0 on success or -1
+int publishWorld(const struct World *world, const char *shmName);
+// map a published world read-only into a world, returns 0 on success or -1
+int attachWorld(struct World *world, const char *shmName);
+// mark a published world retired and remove its name, returns 0 on success or -1
+int retireWorld(const char *shmName);
+
+#endif